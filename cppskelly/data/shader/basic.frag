@@ -0,0 +1,44 @@
+#version 450
+precision highp float;
+
+#ifdef TEXTURED
+in vec2 outTexCoord;
+uniform sampler2D texture; // premultiplied at load, GL_R8 palette indexes when PALETTED
+#ifdef PALETTED
+uniform sampler2D palette; // 256x1 RGBA, premultiplied
+#endif
+#endif
+#ifdef VERTEX_COLOUR
+in vec4 outColour;
+#endif
+#ifdef ALPHA_TEST
+uniform float alphaCutoff;
+#endif
+uniform float additive; // 1: keep colour, drop coverage
+out vec4 fragColour;
+
+void main()
+{
+	fragColour = vec4(1.0);
+#ifdef TEXTURED
+#ifdef PALETTED
+	ivec2 size = textureSize(texture, 0);
+	ivec2 texel = min(ivec2(outTexCoord * vec2(size)), size - 1);
+	int index = int(texelFetch(texture, texel, 0).r * 255.0 + 0.5);
+	fragColour = texelFetch(palette, ivec2(index, 0), 0);
+#else
+	fragColour = texture2D(texture, outTexCoord);
+#endif
+#endif
+#ifdef VERTEX_COLOUR
+	// Vertex colours are straight alpha, the blend state expects premultiplied
+	fragColour *= vec4(outColour.rgb * outColour.a, outColour.a);
+#endif
+#ifdef ALPHA_TEST
+	if (fragColour.a < alphaCutoff)
+	{
+		discard;
+	}
+#endif
+	fragColour.a *= 1.0 - additive;
+}
@@ -0,0 +1,26 @@
+#version 450
+
+#include "include/frame.glsl"
+
+layout(location = 0) in vec2 inPos;
+#ifdef TEXTURED
+layout(location = 1) in vec2 inTexCoord;
+out vec2 outTexCoord;
+#endif
+#ifdef VERTEX_COLOUR
+layout(location = 2) in vec4 inColour;
+out vec4 outColour;
+#endif
+// Instanced, holds 0, 1, 2...: the draw's base instance turns it into the draw's index
+layout(location = 3) in uint inDrawID;
+
+void main()
+{
+	gl_Position = viewProj * draws[inDrawID].model * vec4(inPos.xy, 0.0, 1.0);
+#ifdef TEXTURED
+	outTexCoord = inTexCoord;
+#endif
+#ifdef VERTEX_COLOUR
+	outColour = inColour;
+#endif
+}
@@ -0,0 +1,21 @@
+// Shared by every program, written once per frame (FRAME_UBO_BINDING)
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewProj;
+	mat4 invViewProj;
+	vec4 viewport; // x, y, width, height in pixels
+	float time;    // seconds
+};
+
+// Every draw's data for the frame, uploaded in one go (DRAW_DATA_SSBO_BINDING)
+struct DrawData
+{
+	mat4 model;
+};
+
+layout(std430, binding = 2) readonly buffer DrawDataTable
+{
+	DrawData draws[];
+};
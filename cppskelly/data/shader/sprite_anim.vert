@@ -0,0 +1,34 @@
+#version 450
+
+#include "include/frame.glsl"
+
+uniform vec2 frameSize;
+uniform vec2 pivot;
+uniform int hullPoints; // SPRITE_HULL_MAX_VERTICES, the stride of HullTable
+
+layout(location = 0) in vec2 inPos;
+layout(location = 1) in uint inFrame;
+
+// u0, v0, u1, v1 per frame, v0 at the top of the sheet
+layout(std430, binding = 0) readonly buffer FrameTable
+{
+	vec4 frameUVs[];
+};
+
+// hullPoints outline points per frame, (0,0) at the frame's bottom left
+layout(std430, binding = 1) readonly buffer HullTable
+{
+	vec2 frameHulls[];
+};
+
+out vec2 outTexCoord;
+
+void main()
+{
+	vec2 corner = frameHulls[inFrame * uint(hullPoints) + uint(gl_VertexID)];
+	vec2 pos = inPos + corner * frameSize - pivot;
+	gl_Position = viewProj * vec4(pos, 0.0, 1.0);
+
+	vec4 uv = frameUVs[inFrame];
+	outTexCoord = vec2(mix(uv.x, uv.z, corner.x), mix(uv.w, uv.y, corner.y));
+}
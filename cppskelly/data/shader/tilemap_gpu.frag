@@ -0,0 +1,45 @@
+#version 450
+precision highp float;
+
+in vec2 worldPos;
+
+uniform usampler2D tileIndexes;  // GL_R16UI, one texel per tile
+uniform sampler2DArray tiles;    // one tile per layer, premultiplied
+uniform vec2 mapOrigin;
+uniform vec2 tileSize;
+uniform float additive;
+#ifdef ALPHA_TEST
+uniform float alphaCutoff;
+#endif
+out vec4 fragColour;
+
+const uint TILE_EMPTY = 0xffffu;
+
+void main()
+{
+	vec2 mapPos = (worldPos - mapOrigin) / tileSize;
+	ivec2 tile = ivec2(floor(mapPos));
+	ivec2 mapSize = textureSize(tileIndexes, 0);
+	if (any(lessThan(tile, ivec2(0))) || any(greaterThanEqual(tile, mapSize)))
+	{
+		discard;
+	}
+
+	uint layer = texelFetch(tileIndexes, tile, 0).r;
+	if (layer == TILE_EMPTY)
+	{
+		discard;
+	}
+
+	// Layers are stored top row first, world y grows upwards
+	vec2 uv = fract(mapPos);
+	uv.y = 1.0 - uv.y;
+	fragColour = texture(tiles, vec3(uv, float(layer)));
+#ifdef ALPHA_TEST
+	if (fragColour.a < alphaCutoff)
+	{
+		discard;
+	}
+#endif
+	fragColour.a *= 1.0 - additive;
+}
@@ -0,0 +1,15 @@
+#version 450
+
+#include "include/frame.glsl"
+
+out vec2 worldPos;
+
+void main()
+{
+	// Fullscreen triangle, no vertex buffer needed
+	vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+	gl_Position = vec4(ndc, 0.0, 1.0);
+
+	vec4 world = invViewProj * vec4(ndc, 0.0, 1.0);
+	worldPos = world.xy / world.w;
+}
@@ -0,0 +1,151 @@
+#ifndef ANIMATIONH_H
+#define ANIMATIONH_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "glad/glad.h"
+#include "Drawable.h"
+#include "DrawOrdering.h"
+#include "GeomUtils.h"
+#include "RenderState.h"
+#include "Shader.h"
+#include "SpriteHull.h"
+#include "Texture.h"
+
+extern const char* ANIMATED_SPRITE_SHADER_NAME;
+
+// A run of frames in the sheet's frame table
+struct AnimationClip
+{
+	std::string name;
+	uint32_t firstFrame;
+	uint32_t numFrames;
+	std::vector<float> frameEnds; // Cumulative, seconds
+	float length;
+	float uniformDuration; // > 0 when every frame lasts the same
+	bool loop;
+};
+
+// Frame rects (in texels) for one texture plus the clips that play them. The
+// rects are mirrored on the GPU as a table of uv rects indexed per instance.
+struct SpriteSheet
+{
+	std::string name;
+	TextureHandle texHandle;
+	unsigned int texID;
+	int texWidth;
+	int texHeight;
+
+	std::vector<Rect> frames;
+	std::vector<AnimationClip> clips;
+
+	GLuint frameTableID; // SSBO, vec4(u0, v0, u1, v1) per frame, v0 at the top
+
+	// SPRITE_HULL_MAX_VERTICES outline points per frame, short hulls repeat
+	// their last point. Unit quads until buildSheetHulls runs.
+	std::vector<glm::vec2> hullPoints;
+	GLuint hullTableID;
+
+	SpriteSheet();
+};
+
+bool initSpriteSheet(SpriteSheet& sheet, const std::string& name, const std::string& texPath);
+// -1 if the durations don't match the frames or any isn't positive
+int addClip(SpriteSheet& sheet, const std::string& name, const std::vector<Rect>& frames, const std::vector<float>& durations, bool loop);
+// numFrames cells of a grid of frameWidth x frameHeight texels, starting at (firstColumn, row)
+int addGridClip(SpriteSheet& sheet, const std::string& name, int row, int firstColumn, int numFrames, int frameWidth, int frameHeight, float frameDuration, bool loop);
+int findClip(const SpriteSheet& sheet, const std::string& name);
+// Call after adding clips, before uploadFrameTable. Returns the average coverage.
+float buildSheetHulls(SpriteSheet& sheet, const std::string& texPath);
+void uploadFrameTable(SpriteSheet& sheet);
+void cleanupSpriteSheet(SpriteSheet& sheet);
+
+struct SDL_Window;
+struct Camera;
+
+// Per-instance vertex data, refilled every frame from the SoA arrays
+struct AnimatedInstance
+{
+	GLfloat x, y;
+	GLuint frame;
+};
+
+// Many animated sprites sharing one sheet, stored as structure of arrays so the
+// per-frame update is a tight loop over plain floats. Drawing is one instanced
+// call: each instance carries its position and current frame and the shader
+// fetches the frame's outline and uvs from the sheet's tables, so playing
+// animations never touches vertex data.
+struct AnimatedSpriteBatch : public Drawable
+{
+	std::string name;
+	std::string shaderName;
+	SpriteSheet* sheet;
+	glm::vec2 frameSize; // world units
+	glm::vec2 pivot;
+	BlendMode blendMode;
+
+	std::vector<float> posX;
+	std::vector<float> posY;
+	std::vector<uint16_t> clip;
+	std::vector<float> time;
+	std::vector<float> speed;
+	std::vector<uint32_t> frame; // Absolute frame index, written by updateAnimations
+	std::vector<uint8_t> sortLayer;
+
+	// Fixed step interpolation: positions at the step before the latest and
+	// the blend drawn between them. Drawing uses posX/posY until
+	// interpolateAnimatedSprites is first called.
+	std::vector<float> prevPosX;
+	std::vector<float> prevPosY;
+	std::vector<float> drawPosX;
+	std::vector<float> drawPosY;
+	bool interpolated;
+
+	// Draw by sortLayer then y instead of insertion order
+	bool ySort;
+	DrawOrder drawOrder;
+
+	// Instances outside the camera's view are left out of the upload
+	bool cull;
+	std::vector<uint32_t> visibleList;
+	std::vector<uint8_t> visibleFlags;
+	size_t visibleInstances; // Last draw
+	std::vector<AnimatedInstance> instanceScratch; // Interleaved for the upload, only grows
+
+	GLuint vaoID;
+	GLuint instanceVboID;
+	GLuint eboID;
+	GLuint samplerID;
+	size_t instanceCapacity;
+	mutable ShaderVariantCache shaderVariant;
+
+	AnimatedSpriteBatch(const std::string& name);
+
+	void draw(SDL_Window* w, Camera* c) override;
+	void cleanup() override;
+	DrawSortInfo getSortInfo() const override;
+	// Culls and orders on the update thread, the instances travel in the packet
+	bool recordDraw(FramePacket& packet, PacketDraw& draw) override;
+	void drawRecorded(SDL_Window* w, Camera* c, const FramePacket& packet, const PacketDraw& draw) override;
+};
+
+bool initAnimatedSpriteBatch(AnimatedSpriteBatch& batch, SpriteSheet* sheet, const glm::vec2& frameSize, PivotType pivotType);
+static const size_t NO_ANIMATED_SPRITE = (size_t)-1;
+// The new sprite's index, NO_ANIMATED_SPRITE if the sheet has no such clip
+size_t addAnimatedSprite(AnimatedSpriteBatch& batch, const glm::vec2& pos, int clip, float speed = 1.0f, float startTime = 0.0f);
+void playClip(AnimatedSpriteBatch& batch, size_t sprite, int clip);
+void setSpriteLayer(AnimatedSpriteBatch& batch, size_t sprite, uint8_t layer);
+void updateAnimations(AnimatedSpriteBatch& batch, float dt);
+// Moves time dt through the clip, wrapping or clamping, and returns the frame it lands on
+uint32_t advanceClip(const AnimationClip& clip, float& time, float dt);
+// For batches filled from outside: every per-sprite array gets count entries
+void resizeAnimatedSprites(AnimatedSpriteBatch& batch, size_t count);
+// Call before moving the sprites in a simulation step
+void saveAnimatedSpritePositions(AnimatedSpriteBatch& batch);
+// Positions to draw, alpha of the way from the previous step to the latest
+void interpolateAnimatedSprites(AnimatedSpriteBatch& batch, float alpha);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef BENCHMARKSH_H
+#define BENCHMARKSH_H
+
+#include <cstddef>
+
+// Orders count items by layer and y over a number of simulated frames where
+// most items drift a little and a few jump, and logs the average time per
+// frame for std::sort, the radix sort and the incremental DrawOrder.
+void runDrawOrderBenchmark(size_t count, int frames);
+
+// Tests count random boxes against a view holding about a quarter of them,
+// with the plain loop and the SIMD version, and logs the time per pass.
+void runCullingBenchmark(size_t count, int iterations);
+
+// Rebuilds count bezier lines per frame with parallelFor on 1, 2, 4... up to
+// the hardware's thread count and logs the time per frame and the speedup.
+void runJobBenchmark(size_t count, int frames);
+
+// Updates a TentacleSystem of count tentacles per frame on 1, 2, 4... threads
+// and logs the time per frame and the speedup.
+void runTentacleBenchmark(size_t count, int frames);
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef CAMERAH_H
 #define CAMERAH_H
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
+#include "Culling.h"
 
 struct Camera
 {
@@ -11,9 +13,15 @@ struct Camera
 
 	glm::mat4 viewMatrix;
 	glm::mat4 projMatrix;
+	glm::mat4 viewProjMatrix;    // projMatrix * viewMatrix
+	glm::mat4 invViewProjMatrix; // For unprojecting (view bounds, picking)
 
 	float zNear;
 	float zFar;
+
+	// Set by the setters below, cleared by updateCamera
+	bool viewDirty;
+	bool projDirty;
 };
 
 struct PerspectiveCamera : Camera
@@ -55,10 +63,33 @@ struct OrthoCamera : Camera
 void initOrtho(OrthoCamera* cam, const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up, const glm::vec4& borders, float zNear, float zFar);
 void initPerspective(PerspectiveCamera* cam, const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up, float fov, float aspect, float zNear, float zFar);
 
+// Setters mark what they touch as dirty, nothing is recomputed until updateCamera
+void setCameraLookAt(Camera* cam, const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up);
+void moveCamera(Camera* cam, const glm::vec3& delta);
+void setOrthoBorders(OrthoCamera* cam, const glm::vec4& borders);
+void setPerspective(PerspectiveCamera* cam, float fov, float aspect);
+
+// Rebuilds the dirty matrices and the cached view-projection. Call once per
+// frame before drawing; returns true if anything changed.
+bool updateCamera(OrthoCamera* cam);
+bool updateCamera(PerspectiveCamera* cam);
+
+// Unconditional rebuilds, these also refresh the view-projection
 void updateCameraViewMatrix(Camera* cam);
 void updateCameraProjectionMatrix(PerspectiveCamera* cam);
 void updateCameraProjectionMatrix(OrthoCamera* cam);
 
+// World-space rectangle the camera sees on the z = planeZ plane (the plane all
+// sprites, lines and tilemaps currently live on)
+bool getViewBounds(const Camera* cam, float planeZ, glm::vec2& minPos, glm::vec2& maxPos);
+
+// Box to cull against this frame, for ortho and perspective cameras alike
+bool getCullBounds(const Camera* cam, Bounds2D& bounds);
+inline bool isVisible(const Bounds2D& cullBounds, const Bounds2D& bounds)
+{
+	return overlaps(cullBounds, bounds);
+}
+
 
 static OrthoCamera gCam;
 static PerspectiveCamera gPerspectiveCam;
@@ -0,0 +1,48 @@
+#ifndef CULLINGH_H
+#define CULLINGH_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// World-space axis aligned box on the z = 0 plane
+struct Bounds2D
+{
+	glm::vec2 minPos;
+	glm::vec2 maxPos;
+};
+
+inline bool overlaps(const Bounds2D& a, const Bounds2D& b)
+{
+	return a.minPos.x <= b.maxPos.x && a.maxPos.x >= b.minPos.x
+		&& a.minPos.y <= b.maxPos.y && a.maxPos.y >= b.minPos.y;
+}
+
+// Box around the local box after scaling, rotating and translating it
+Bounds2D transformBounds(const Bounds2D& local, const glm::vec2& pos, const glm::vec2& scale, float angle);
+// Box around interleaved x, y pairs; false when there are none
+bool computeBounds(const float* xy, size_t numPoints, Bounds2D& bounds);
+
+// Bounds for many objects, one array per component so the tests below can
+// check four boxes per instruction
+struct BoundsSoA
+{
+	std::vector<float> minX;
+	std::vector<float> minY;
+	std::vector<float> maxX;
+	std::vector<float> maxY;
+};
+
+void clearBounds(BoundsSoA& bounds);
+void addBounds(BoundsSoA& bounds, const Bounds2D& box);
+
+// Writes the indexes of the boxes overlapping view and returns how many.
+// visible needs room for every index.
+size_t cullBoundsSoA(const BoundsSoA& bounds, const Bounds2D& view, uint32_t* visible);
+// Same for points, for objects that share one size: grow view by that size first
+size_t cullPointsSoA(const float* x, const float* y, size_t count, const Bounds2D& view, uint32_t* visible);
+// Plain loop version of cullBoundsSoA, kept for comparison
+size_t cullBoundsScalar(const BoundsSoA& bounds, const Bounds2D& view, uint32_t* visible);
+
+#endif
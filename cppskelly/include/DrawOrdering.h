@@ -0,0 +1,45 @@
+#ifndef DRAWORDERINGH_H
+#define DRAWORDERINGH_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "RenderQueue.h"
+
+// Maps a float to a uint32 with the same ordering, negatives included
+inline uint32_t floatToSortable(float f)
+{
+	union { float f; uint32_t u; } bits;
+	bits.f = f;
+	return (bits.u & 0x80000000u) ? ~bits.u : (bits.u | 0x80000000u);
+}
+
+// Layer first, then top-down depth: y grows upwards, so higher sprites are
+// further away and draw first
+inline uint64_t makeDrawOrderKey(uint8_t layer, float y)
+{
+	return ((uint64_t)layer << 32) | floatToSortable(-y);
+}
+
+// Back-to-front order for a set of items, kept across frames. Items barely
+// move between frames, so last frame's order is almost sorted and an
+// insertion sort over it is close to linear. When too much has changed (the
+// sort runs over its shift budget, or items were added or removed) it falls
+// back to a radix sort on the keys.
+struct DrawOrder
+{
+	std::vector<RenderQueueEntry> entries; // index = item, in draw order
+	std::vector<RenderQueueEntry> scratch;
+	float maxShiftsPerItem; // insertion sort budget before giving up
+
+	// Last update's numbers
+	size_t shifts;
+	bool usedRadixSort;
+
+	DrawOrder();
+};
+
+void updateDrawOrder(DrawOrder& order, const uint8_t* layers, const float* y, size_t count);
+void resetDrawOrder(DrawOrder& order);
+
+#endif
@@ -1,11 +1,66 @@
 #ifndef DrawableH_H
 #define DrawableH_H
 
+#include <cstdint>
+#include "Culling.h"
+
+// What the render queue orders draws by
+struct DrawSortInfo
+{
+	uint8_t layer;
+	bool translucent;
+	unsigned int shaderID;
+	unsigned int textureID;
+	float depth; // 0 (near) to 1 (far)
+};
+
 struct SDL_Window;
 struct Camera;
+struct DrawData;
+struct FramePacket;
+struct PacketDraw;
 struct Drawable
 {
+	uint8_t layer; // Draw order across layers is fixed, within a layer the queue may reorder
+	uint32_t drawIndex; // This frame's DrawData entry, 0 (identity) if it has none
+
+	Drawable() : layer(0), drawIndex(0) {}
+	virtual ~Drawable() {}
+
 	virtual void draw(SDL_Window* w, Camera* c) = 0;
 	virtual void cleanup() = 0;
+
+	// Drawables that don't override this sort as translucent with no state,
+	// so they keep their submission order within their layer
+	virtual DrawSortInfo getSortInfo() const
+	{
+		return DrawSortInfo{ layer, true, 0, 0, 0.0f };
+	}
+
+	// World bounds for culling, false if unknown (never culled)
+	virtual bool getBounds(Bounds2D& bounds) const
+	{
+		return false;
+	}
+
+	// Per-draw shader data, gathered for every queued drawable before drawing
+	virtual bool getDrawData(DrawData& data) const
+	{
+		return false;
+	}
+
+	// Record mode, on the update thread: copy whatever changes per frame into
+	// the packet (draw data and bounds are already taken care of). False skips
+	// the draw. The default suits drawables that only change at setup.
+	virtual bool recordDraw(FramePacket& packet, PacketDraw& draw)
+	{
+		return true;
+	}
+
+	// Record mode, on the render thread: draw from what recordDraw copied
+	virtual void drawRecorded(SDL_Window* w, Camera* c, const FramePacket& packet, const PacketDraw& draw)
+	{
+		this->draw(w, c);
+	}
 };
 #endif
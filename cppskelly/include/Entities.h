@@ -0,0 +1,160 @@
+#ifndef ENTITIESH_H
+#define ENTITIESH_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Low 24 bits index the world's records, the top 8 count reuses of the slot
+// so a stale ID stops matching once its entity is destroyed
+typedef uint32_t EntityID;
+static const EntityID INVALID_ENTITY = 0xffffffff;
+
+enum ComponentType
+{
+	COMPONENT_POSITION,
+	COMPONENT_PREVIOUS_POSITION,
+	COMPONENT_VELOCITY,
+	COMPONENT_ANIMATION,
+	COMPONENT_SPRITE_INSTANCE,
+	COMPONENT_WALKER,
+	COMPONENT_PLAYER_CONTROL,
+	NUM_COMPONENT_TYPES
+};
+
+typedef uint32_t ComponentMask;
+inline ComponentMask componentBit(ComponentType type)
+{
+	return 1u << type;
+}
+
+// Components are plain data, a system reads the arrays it needs and no others
+struct Position
+{
+	static const ComponentType TYPE = COMPONENT_POSITION;
+	float x, y;
+};
+
+// Where the last fixed step left it, for drawing in between
+struct PreviousPosition
+{
+	static const ComponentType TYPE = COMPONENT_PREVIOUS_POSITION;
+	float x, y;
+};
+
+struct Velocity
+{
+	static const ComponentType TYPE = COMPONENT_VELOCITY;
+	float x, y;
+};
+
+// A clip of the sprite sheet the entities are drawn from
+struct AnimationState
+{
+	static const ComponentType TYPE = COMPONENT_ANIMATION;
+	uint16_t clip;
+	float time;
+	float speed;
+	uint32_t frame; // Absolute frame index
+};
+
+// Drawn by an AnimatedSpriteBatch, needs Position and AnimationState
+struct SpriteInstance
+{
+	static const ComponentType TYPE = COMPONENT_SPRITE_INSTANCE;
+	uint8_t sortLayer;
+};
+
+// Wanders the four directions at its own pace
+struct Walker
+{
+	static const ComponentType TYPE = COMPONENT_WALKER;
+	float speed;
+	uint32_t rng; // xorshift state, per entity so walkers update in parallel
+};
+
+// Velocity follows the input axes
+struct PlayerControl
+{
+	static const ComponentType TYPE = COMPONENT_PLAYER_CONTROL;
+	float speed;
+};
+
+// Entities per chunk. Every component array in a chunk is this long, so a
+// system walks a few contiguous arrays and a chunk is a natural job.
+static const size_t ENTITY_CHUNK_CAPACITY = 1024;
+
+struct EntityChunk
+{
+	ComponentMask mask;
+	size_t count;
+	std::vector<EntityID> entities;
+	std::vector<uint8_t> components[NUM_COMPONENT_TYPES]; // Empty unless in mask
+
+	EntityChunk();
+};
+
+// All entities with exactly the same set of components. Removing one moves
+// the chunk's last entity into its row, so the arrays stay dense.
+struct Archetype
+{
+	ComponentMask mask;
+	std::vector<EntityChunk> chunks; // Only the last one has room
+};
+
+struct EntityRecord
+{
+	uint32_t archetype;
+	uint32_t chunk;
+	uint32_t row;
+	uint8_t generation;
+	bool alive;
+};
+
+struct EntityWorld
+{
+	std::vector<Archetype> archetypes;
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeRecords;
+	size_t numEntities;
+
+	EntityWorld();
+};
+
+// Components start zeroed
+EntityID createEntity(EntityWorld& world, ComponentMask mask);
+void destroyEntity(EntityWorld& world, EntityID entity);
+bool isEntityAlive(const EntityWorld& world, EntityID entity);
+// Adds and removes components by moving the entity to the matching archetype.
+// The ones it keeps keep their values, new ones start zeroed.
+void setEntityComponents(EntityWorld& world, EntityID entity, ComponentMask mask);
+ComponentMask getEntityComponents(const EntityWorld& world, EntityID entity);
+void* getComponentData(EntityWorld& world, EntityID entity, ComponentType type);
+
+template <typename T>
+T* getComponent(EntityWorld& world, EntityID entity)
+{
+	return (T*)getComponentData(world, entity, T::TYPE);
+}
+
+template <typename T>
+T* getChunkComponents(EntityChunk& chunk)
+{
+	return (T*)chunk.components[T::TYPE].data();
+}
+
+inline bool chunkHas(const EntityChunk& chunk, ComponentType type)
+{
+	return (chunk.mask & componentBit(type)) != 0;
+}
+
+// Every non-empty chunk whose archetype has at least the required components.
+// Pointers hold until entities are next created or moved.
+void queryChunks(EntityWorld& world, ComponentMask required, std::vector<EntityChunk*>& chunks);
+// Runs body once per matching chunk, chunks spread across the job threads.
+// Bodies may write their own chunk's components but must not create, destroy
+// or move entities.
+void forEachChunk(EntityWorld& world, ComponentMask required, const std::function<void(EntityChunk& chunk)>& body);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef ENTITYSYSTEMSH_H
+#define ENTITYSYSTEMSH_H
+
+#include <glm/glm.hpp>
+#include "Entities.h"
+
+struct SpriteSheet;
+struct AnimatedSpriteBatch;
+
+// Each system touches only the components it names and runs a chunk per job.
+// The first three advance one fixed step, the last runs once per frame.
+
+// Velocity = axis * speed for everything with PlayerControl
+void updatePlayerControl(EntityWorld& world, const glm::vec2& axis);
+// Position += Velocity * dt, keeping the old one in PreviousPosition where there is one
+void updateMovement(EntityWorld& world, float dt);
+// Plays each AnimationState's clip from the sheet
+void updateEntityAnimations(EntityWorld& world, const SpriteSheet& sheet, float dt);
+// Refills the batch from every SpriteInstance, positions alpha of the way
+// from PreviousPosition to Position. Chunk order is kept, so the batch's
+// incremental y-sort stays warm while no entities are added or removed.
+void extractSpriteInstances(EntityWorld& world, AnimatedSpriteBatch& batch, float alpha);
+
+#endif
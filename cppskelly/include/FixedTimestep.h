@@ -0,0 +1,26 @@
+#ifndef FIXEDTIMESTEPH_H
+#define FIXEDTIMESTEPH_H
+
+#include <cstdint>
+
+// Simulation always advances in steps of the same length, however long the
+// frame took: frame time goes into an accumulator and whole steps come out.
+// Rendering then blends the last two steps by what's left over.
+struct FixedTimestep
+{
+	double stepSeconds;
+	double accumulator;
+	int maxStepsPerFrame; // More than this and the leftover time is dropped
+	uint64_t steps;       // Taken since init
+	uint64_t droppedSteps;
+
+	FixedTimestep();
+};
+
+void initFixedTimestep(FixedTimestep& timestep, double hz, int maxStepsPerFrame = 5);
+// Adds a frame's time and returns how many steps to run for it
+int advanceFixedTimestep(FixedTimestep& timestep, double frameSeconds);
+// How far rendering is between the previous step (0) and the latest one (1)
+float getInterpolationAlpha(const FixedTimestep& timestep);
+
+#endif
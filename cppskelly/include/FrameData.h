@@ -0,0 +1,68 @@
+#ifndef FRAMEDATAH_H
+#define FRAMEDATAH_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "glad/glad.h"
+
+// Fixed bindings, the shaders hardcode the same numbers
+static const GLuint FRAME_UBO_BINDING = 0;
+static const GLuint DRAW_DATA_SSBO_BINDING = 2; // 0 and 1 are the sprite sheet tables
+static const GLuint DRAW_ID_ATTR = 3;
+
+// std140 mirror of the shaders' FrameBlock
+struct FrameUniforms
+{
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::mat4 viewProj;
+	glm::mat4 invViewProj;
+	glm::vec4 viewport; // x, y, width, height in pixels
+	float time;         // seconds
+	float padding[3];
+};
+
+// std430 mirror of one entry in the shaders' DrawDataTable
+struct DrawData
+{
+	glm::mat4 model;
+};
+
+// Everything the shaders read that isn't vertex data or textures. Frame-wide
+// values sit in one UBO bound for the whole frame, per-draw values are
+// gathered into one SSBO and uploaded once. A draw finds its entry through an
+// instanced attribute holding 0, 1, 2... offset by the draw's base instance,
+// so selecting it costs nothing but the draw call's own argument.
+struct FrameData
+{
+	GLuint uboID;
+	GLuint drawDataID;   // SSBO
+	GLuint drawIdVboID;  // Instanced uint attribute, element i holds i
+	size_t capacity;     // Entries both buffers can hold
+	std::vector<DrawData> draws; // Entry 0 is always the identity
+};
+
+extern FrameData gFrameData;
+
+bool initFrameData(FrameData& frame);
+void cleanupFrameData(FrameData& frame);
+
+struct Camera;
+void publishFrameUniforms(FrameData& frame, const Camera* cam, float time, int viewportWidth, int viewportHeight);
+
+// Per-draw entries: clear, add one per drawable needing it, then upload once
+void clearDrawData(FrameData& frame);
+uint32_t addDrawData(FrameData& frame, const DrawData& data);
+void uploadDrawData(FrameData& frame);
+
+// Points DRAW_ID_ATTR of the bound VAO at the id buffer
+void enableDrawIDAttribute(const FrameData& frame);
+// For VAOs without the attribute: every vertex reads entry 0
+void setDefaultDrawID();
+
+glm::mat4 buildModelMatrix(const glm::vec2& pos, float angle, const glm::vec2& scale);
+
+#endif
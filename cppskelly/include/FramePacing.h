@@ -0,0 +1,80 @@
+#ifndef FRAMEPACINGH_H
+#define FRAMEPACINGH_H
+
+#include <chrono>
+#include <cstdint>
+#include <SDL.h>
+
+typedef std::chrono::steady_clock TPacingClock;
+
+// Values match SDL_GL_SetSwapInterval's
+enum class VsyncMode : int
+{
+	Adaptive = -1, // Tears instead of waiting a whole refresh when a frame is late
+	Off = 0,
+	On = 1
+};
+
+// Running mean and variance (Welford), plus the extremes
+struct FrameTimeStats
+{
+	uint64_t count;
+	double mean;
+	double m2;
+	double min;
+	double max;
+
+	FrameTimeStats();
+};
+
+void addFrameTime(FrameTimeStats& stats, double seconds);
+double getFrameTimeStdDev(const FrameTimeStats& stats);
+void resetFrameTimeStats(FrameTimeStats& stats);
+
+// Caps the update loop's rate. Waiting sleeps while there's clearly time for
+// it and spins through the last stretch, where a sleep could oversleep. How
+// much a sleep overshoots is measured as we go, so the spin is only as long
+// as this machine's scheduler needs.
+struct FramePacer
+{
+	VsyncMode vsync;      // What the driver accepted
+	double targetSeconds; // 0: uncapped
+	TPacingClock::time_point nextFrame;
+
+	// Start frames this long before the next predicted vsync, 0: as soon as possible
+	double vsyncLeadSeconds;
+	double refreshSeconds;
+	TPacingClock::time_point lastPresent;
+
+	FrameTimeStats sleepTimes; // Actual length of 1 ms sleeps
+	FrameTimeStats frameTimes;
+	FrameTimeStats swapTimes;  // Time SDL_GL_SwapWindow blocked
+
+	FramePacer();
+};
+
+// Call with the context current. Adaptive falls back to on where the driver
+// doesn't support it, on falls back to off.
+VsyncMode setVsyncMode(FramePacer& pacer, VsyncMode mode);
+bool parseVsyncMode(const char* name, VsyncMode& mode);
+const char* getVsyncModeName(VsyncMode mode);
+
+// fps <= 0 removes the cap
+void setFrameCap(FramePacer& pacer, double fps);
+// Blocks until the next frame is due, call once per frame
+void waitForNextFrame(FramePacer& pacer);
+
+// Vsyncs are predicted from the last present and the display's refresh rate
+void setRefreshRate(FramePacer& pacer, int hz);
+void notePresent(FramePacer& pacer, TPacingClock::time_point presentTime);
+// With vsync on and a lead set, blocks until vsyncLeadSeconds before the next
+// vsync, so input sampled straight after is as fresh as the frame allows
+void waitForVsyncLead(FramePacer& pacer);
+
+// Swaps and returns how long the call blocked, for swapTimes
+double swapWindowTimed(SDL_Window* w);
+
+// Mean, spread and extremes since the last log, then starts over
+void logFramePacing(FramePacer& pacer);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef FRAMEPACKETH_H
+#define FRAMEPACKETH_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "Camera.h"
+#include "Drawable.h"
+#include "FrameData.h"
+#include "FramePacing.h"
+#include "LatencyHarness.h"
+#include "RenderQueue.h"
+
+// One drawable's draw as recorded by the update thread
+struct PacketDraw
+{
+	Drawable* drawable;
+	bool hasDrawData;
+	DrawData drawData;
+	uint32_t dataOffset; // Payload in FramePacket::data (vertices, instances...)
+	uint32_t dataSize;   // bytes, 0 if the drawable copied nothing
+};
+
+// Everything the render thread needs to draw a frame, written by the update
+// thread and not touched by it again until the render thread hands it back.
+// Drawables copy whatever changes per frame (transforms, vertices, instances)
+// into it, so the update thread is free to carry on with the next frame.
+struct FramePacket
+{
+	uint64_t frame;
+	OrthoCamera camera;
+	float time;
+	int viewportWidth;
+	int viewportHeight;
+	bool depthPrepass;
+	// Late latching: the render thread may swap in a newer camera, up to
+	// cullMargin world units away, so culling leaves that much slack
+	bool lateLatch;
+	float cullMargin;
+	TPacingClock::time_point inputTime; // When the camera was sampled
+	uint32_t latencyProbe; // Tagged by the latency harness, NO_LATENCY_PROBE if not
+	TPacingClock::time_point submitTime;
+
+	std::vector<PacketDraw> draws;
+	std::vector<uint8_t> data;
+	int culled; // Left out by recordFramePacket
+
+	// Written by the render thread, valid once the packet comes back
+	bool rendered;
+	RenderQueueStats stats;
+	uint64_t fragments;
+	double swapSeconds; // How long presenting blocked
+	TPacingClock::time_point presentTime; // When the swap returned
+	double latchGainSeconds; // How much newer the latched camera was than inputTime
+	TPacingClock::time_point gpuDoneTime; // Probed frames only
+
+	FramePacket();
+};
+
+void beginFramePacket(FramePacket& packet, uint64_t frame, const OrthoCamera& camera, float time, int viewportWidth, int viewportHeight);
+// Culls against the packet's camera, then asks each visible drawable to
+// record itself
+void recordFramePacket(FramePacket& packet, const std::vector<Drawable*>& drawables, bool cull);
+
+// Copies size bytes into the packet, returns their offset
+uint32_t appendPacketData(FramePacket& packet, const void* src, size_t size);
+inline const void* getPacketData(const FramePacket& packet, const PacketDraw& draw)
+{
+	return packet.data.data() + draw.dataOffset;
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef GLUTILSH_H
+#define GLUTILSH_H
+
+// Whether the current context advertises the extension. Needs a current context.
+bool hasGLExtension(const char* name);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef GPUSTATSH_H
+#define GPUSTATSH_H
+
+#include <cstdint>
+#include "glad/glad.h"
+
+// ARB_pipeline_statistics_query, not in our glad build
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#endif
+
+static const int GPU_QUERY_FRAMES = 4; // Results are read this many frames late so we never stall
+
+// Fragments shaded per frame. Uses the pipeline statistics query when the
+// driver has it, otherwise GL_SAMPLES_PASSED (samples surviving the depth
+// test, which still shows what early-Z rejects).
+struct FragmentCounter
+{
+	GLuint queries[GPU_QUERY_FRAMES];
+	bool pending[GPU_QUERY_FRAMES];
+	int current;
+	GLenum target;
+	bool active;
+
+	uint64_t lastCount; // Most recent frame with a result
+
+	FragmentCounter();
+};
+
+bool initFragmentCounter(FragmentCounter& counter);
+void beginFragmentCount(FragmentCounter& counter);
+void endFragmentCount(FragmentCounter& counter);
+void cleanupFragmentCounter(FragmentCounter& counter);
+
+#endif
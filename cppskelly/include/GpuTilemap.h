@@ -0,0 +1,68 @@
+#ifndef GPUTILEMAPH_H
+#define GPUTILEMAPH_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "glad/glad.h"
+#include "Drawable.h"
+#include "RenderState.h"
+#include "Shader.h"
+
+extern const char* GPU_TILEMAP_SHADER_NAME;
+static const uint16_t GPU_TILE_EMPTY = 0xffff;
+
+struct SDL_Window;
+struct Camera;
+
+// Tilemap resolved entirely in the fragment shader: the map is a GL_R16UI
+// texture of layer indexes into a GL_TEXTURE_2D_ARRAY holding one tile per
+// layer, and a single fullscreen triangle covers the screen. Moving the camera
+// costs no CPU geometry work and an edit is a one texel upload.
+// Assumes an ortho camera looking down -z, like gCam.
+struct GpuTilemap : public Drawable
+{
+	std::string name;
+	std::string shaderName;
+
+	int width; // tiles
+	int height;
+	glm::vec2 tileSize; // world units
+	glm::vec2 origin;
+
+	int tileTexelWidth;
+	int tileTexelHeight;
+	int numLayers;
+	std::vector<int> sheetFirstLayer; // Layer of each sheet's first tile
+
+	GLuint indexTexID;
+	GLuint tileArrayTexID;
+	GLuint vaoID; // Empty, core profile needs one bound to draw
+	mutable ShaderVariantCache shaderVariant;
+
+	BlendMode blendMode;
+
+	GpuTilemap(const std::string& name);
+
+	void draw(SDL_Window* w, Camera* c) override;
+	void cleanup() override;
+	DrawSortInfo getSortInfo() const override;
+	bool getBounds(Bounds2D& bounds) const override;
+};
+
+// Slices every sheet into tileWidth x tileHeight tiles (left to right, top to
+// bottom) and stacks them in one texture array, in the order given. Fails if
+// any sheet fails to load, since the layers of the ones after it would shift.
+bool initGpuTilemap(GpuTilemap& map, const std::vector<std::string>& sheetPaths, int tileWidth, int tileHeight, int width, int height, const glm::vec2& tileSize);
+
+inline uint16_t gpuTileLayer(const GpuTilemap& map, int sheet, int tile)
+{
+	return (uint16_t)(map.sheetFirstLayer[sheet] + tile);
+}
+
+void setGpuTile(GpuTilemap& map, int x, int y, uint16_t layer);
+void setGpuTiles(GpuTilemap& map, const std::vector<uint16_t>& layers);
+
+#endif
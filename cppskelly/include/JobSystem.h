@@ -0,0 +1,50 @@
+#ifndef JOBSYSTEMH_H
+#define JOBSYSTEMH_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+typedef std::function<void()> TJobFunc;
+
+struct JobCounter;
+
+struct Job
+{
+	TJobFunc func;
+	JobCounter* counter; // Decremented once func returns, may be null
+};
+
+// Number of unfinished jobs signed up to it. Jobs queued with runJobAfter are
+// held here until it reaches zero.
+struct JobCounter
+{
+	std::atomic<int> pending;
+	std::mutex mutex;
+	std::vector<Job> continuations;
+
+	JobCounter() : pending(0) {}
+};
+
+// Every thread, the caller's included, owns a deque of jobs: it pushes and pops
+// at the back and, when its own runs dry, steals from the front of the others'.
+// numThreads 0 uses one per hardware thread. The thread calling init counts as
+// thread 0 and only runs jobs while it waits on a counter.
+bool initJobSystem(int numThreads = 0);
+void shutdownJobSystem();
+int getJobThreadCount();
+
+// Without an initialised job system jobs run inline
+void runJob(const TJobFunc& func, JobCounter* counter = nullptr);
+// Queues func once dependency's pending jobs are all done
+void runJobAfter(JobCounter& dependency, const TJobFunc& func, JobCounter* counter = nullptr);
+// Runs queued jobs until counter reaches zero
+void waitForCounter(JobCounter& counter);
+
+// Splits [0, count) into ranges of at least grain items, runs body on each
+// across the threads and returns when all are done
+void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef LATELATCHH_H
+#define LATELATCHH_H
+
+#include <cstdint>
+#include <mutex>
+
+#include "Camera.h"
+#include "FramePacing.h"
+
+// The newest camera the update thread has sampled from input. The render
+// thread reads it just before publishing the frame's uniforms, so the view
+// it draws with can be newer than the frame it's drawing, by up to the whole
+// frame the update thread has moved on to since.
+struct CameraLatch
+{
+	std::mutex mutex;
+	OrthoCamera camera;
+	TPacingClock::time_point sampleTime;
+	uint64_t sequence; // 0 until something is latched
+
+	CameraLatch();
+};
+
+void latchCamera(CameraLatch& latch, const OrthoCamera& camera, TPacingClock::time_point sampleTime);
+// False if nothing has been latched yet
+bool readLatchedCamera(CameraLatch& latch, OrthoCamera& camera, TPacingClock::time_point& sampleTime);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef LATENCYHARNESSH_H
+#define LATENCYHARNESSH_H
+
+#include <cstdint>
+#include <vector>
+#include <SDL.h>
+
+#include "FramePacing.h"
+
+struct FramePacket;
+
+static const uint32_t NO_LATENCY_PROBE = 0xffffffff;
+
+// One synthetic input followed from injection to the GPU finishing the
+// frame that first saw it
+struct LatencyProbe
+{
+	TPacingClock::time_point injected;  // Pushed onto SDL's event queue
+	TPacingClock::time_point handled;   // Polled by handleInput
+	TPacingClock::time_point submitted; // Its frame's packet went to the render thread
+	TPacingClock::time_point presented; // SDL_GL_SwapWindow returned
+	TPacingClock::time_point gpuDone;   // The fence after the swap signalled
+	uint64_t frame;
+	bool complete;
+};
+
+// Measures input-to-photon latency without anyone at the keyboard: pushes a
+// user event every few frames, tags the frame that handles it and collects
+// the timestamps when that frame's packet comes back. Photons are
+// approximated by the swap returning and by the GPU finishing the frame.
+struct LatencyHarness
+{
+	bool active;
+	Uint32 eventType;
+	int intervalFrames; // Frames between probes
+	int framesUntilProbe;
+	size_t targetProbes;
+	std::vector<LatencyProbe> probes; // Indexed by probe id
+
+	LatencyHarness();
+};
+
+bool initLatencyHarness(LatencyHarness& harness, size_t numProbes, int intervalFrames);
+// Call once per frame before handling input
+void injectLatencyProbe(LatencyHarness& harness);
+// The probe id if event is one of ours, NO_LATENCY_PROBE otherwise
+uint32_t getLatencyProbe(LatencyHarness& harness, const SDL_Event& event);
+// The probe's input has been applied to the frame being recorded
+void tagLatencyProbe(LatencyHarness& harness, uint32_t probe, uint64_t frame, FramePacket& packet);
+// Render thread, after the swap: fences the frame and waits for the GPU.
+// Only probed frames wait, the rest keep their pipelining.
+void finishLatencyProbeFrame(FramePacket& packet);
+// Update thread, for every packet that comes back rendered
+void collectLatencyProbe(LatencyHarness& harness, const FramePacket& packet);
+bool isLatencyHarnessDone(const LatencyHarness& harness);
+// Distributions (min, median, 95th, 99th, max) for each stage
+void logLatencyReport(const LatencyHarness& harness);
+
+#endif
@@ -8,6 +8,8 @@
 #include <array>
 #include <glm/glm.hpp>
 #include "Drawable.h"
+#include "RenderState.h"
+#include "Shader.h"
 
 static const int NUM_LINE_VBO = 2;
 extern const int NUM_LINE_VAO;
@@ -35,8 +37,8 @@ struct LineRenderer: public Drawable
 	std::string texPath;
 	std::string shaderName;
 	unsigned int texID;
-	unsigned int shaderID;
 	unsigned int samplerID;
+	mutable ShaderVariantCache shaderVariant;
 	
 	glm::vec2 pos = { 0.f,0.f };
 	glm::vec2 scale = { 1.f,1.f }; // Will this make sense?
@@ -48,14 +50,14 @@ struct LineRenderer: public Drawable
 	glm::vec2 acceleration;
 
 	glm::vec2 pivot;
-	glm::mat4 modelMatrix;
 
-	bool alphaBlend;
+	BlendMode blendMode;
 
 	std::vector<GLfloat> vertices;
 	std::vector<GLfloat> colours;
 	std::vector<GLfloat> uvs;
 	std::vector<GLuint> indexes;
+	Bounds2D localBounds; // Around the vertices, before pos/scale/angle
 
 	float lineWidth;
 	GLfloat colourRGBA[4];
@@ -67,15 +69,21 @@ struct LineRenderer: public Drawable
 
 	void draw(SDL_Window* w, Camera* c) override;
 	void cleanup() override;
+	DrawSortInfo getSortInfo() const override;
+	bool getBounds(Bounds2D& bounds) const override;
+	bool getDrawData(DrawData& data) const override;
+	// Vertices travel in the packet, colours and indexes are set up once
+	bool recordDraw(FramePacket& packet, PacketDraw& draw) override;
+	void drawRecorded(SDL_Window* w, Camera* c, const FramePacket& packet, const PacketDraw& draw) override;
 	void setPointColours(const std::vector<GLfloat>& pointColours);
 
 	LineRenderer(const std::string& name)
 		:name(name)
 		, texPath(), shaderName()
-		, texID(0), shaderID(0), samplerID(0)
+		, texID(0), samplerID(0), shaderVariant()
 		, angle(0.0f)
 		, pos(), scale(1.0f, 1.0f)
-		, pivot(), modelMatrix(), alphaBlend(false)
+		, pivot(), blendMode(BlendMode::Opaque)
 	{}
 };
 
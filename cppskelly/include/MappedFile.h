@@ -0,0 +1,31 @@
+#ifndef MAPPEDFILEH_H
+#define MAPPEDFILEH_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file. Pages are loaded by the OS on
+// first touch, so callers only pay for the parts they actually read.
+struct MappedFile
+{
+	const uint8_t* data;
+	size_t size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fd;
+#endif
+
+	MappedFile();
+};
+
+bool openMappedFile(const std::string& path, MappedFile& file);
+void closeMappedFile(MappedFile& file);
+
+// Paging hints: willNeed starts reading the range in ahead of use, otherwise
+// the range's pages may be dropped (they are re-read from disk if touched).
+void adviseMappedRange(const MappedFile& file, size_t offset, size_t size, bool willNeed);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef RENDERQUEUEH_H
+#define RENDERQUEUEH_H
+
+#include <vector>
+#include <cstdint>
+#include "Drawable.h"
+
+// 64 bit sort key, most significant first:
+//   layer (8) | translucent (1) | opaque:      shader (12) | texture (16) | depth (24)
+//                               | translucent: far-to-near depth (24) | shader (12) | texture (16)
+// Opaque draws group by state and go front to back; translucent ones must stay
+// back to front, so state only breaks ties between equal depths. The low 3
+// bits are unused. Shader and texture fields hold the low bits of the GL names,
+// a clash only costs a state change.
+uint64_t makeSortKey(const DrawSortInfo& info);
+
+struct RenderQueueEntry
+{
+	uint64_t key;
+	uint32_t index; // Into RenderQueue::drawables/infos
+};
+
+struct RenderQueueStats
+{
+	int commands;
+	int stateChangesUnsorted; // What submission order would have cost
+	int stateChangesSorted;
+	int radixPasses;          // Out of 8, passes where every key shares a byte are skipped
+	int culled;               // Rejected at submit for being outside the view
+};
+
+struct SDL_Window;
+struct Camera;
+struct FramePacket;
+struct PacketDraw;
+
+// Per frame list of draws. Drawables are submitted in any order, sorted by key
+// with a stable LSD radix sort and drawn in that order.
+//
+// With depthPrepass set the queue draws in two passes: opaque draws front to
+// back writing depth, so whatever they cover is rejected before shading, then
+// translucent ones back to front testing against it. Layers become depths
+// through the depth range, so no shader needs to know about them.
+struct RenderQueue
+{
+	std::vector<Drawable*> drawables;
+	std::vector<const PacketDraw*> recorded; // Per drawable, null unless it came from packet
+	const FramePacket* packet;
+	std::vector<DrawSortInfo> infos;
+	std::vector<RenderQueueEntry> entries;
+	std::vector<RenderQueueEntry> scratch;
+	RenderQueueStats stats;
+	bool depthPrepass;
+	bool cull;          // Skip drawables outside the camera's view
+	bool hasCullBounds; // The camera could give a view rect this frame
+	Bounds2D cullBounds;
+
+	RenderQueue();
+};
+
+// Also picks up the camera's cull bounds for this frame's submissions
+void clearRenderQueue(RenderQueue& queue, const Camera* c);
+void submitDrawable(RenderQueue& queue, Drawable* drawable);
+// Queues every draw recorded in the packet, which was culled when recorded.
+// The packet has to outlive the flush.
+void submitPacketDraws(RenderQueue& queue, const FramePacket& packet);
+void sortRenderQueue(RenderQueue& queue);
+// Window depth for a layer, higher layers are nearer
+float layerDepth(uint8_t layer);
+void flushRenderQueue(RenderQueue& queue, SDL_Window* w, Camera* c);
+
+// Sorts entries by key in place, scratch is resized to match. Returns the
+// number of passes actually run.
+int radixSortEntries(std::vector<RenderQueueEntry>& entries, std::vector<RenderQueueEntry>& scratch);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef RENDERSTATEH_H
+#define RENDERSTATEH_H
+
+// Everything is drawn with premultiplied alpha: textures are premultiplied when
+// loaded and the fragment shaders output premultiplied colour. That lets normal
+// and additive blending share GL_ONE, GL_ONE_MINUS_SRC_ALPHA (additive just
+// writes alpha = 0), so switching between them never changes GL state.
+enum class BlendMode
+{
+	Opaque,
+	Alpha,
+	Additive
+};
+
+void applyBlendMode(BlendMode mode);
+void invalidateRenderState();
+
+// Value for the fragment shaders' "additive" uniform
+inline float additiveFactor(BlendMode mode)
+{
+	return mode == BlendMode::Additive ? 1.0f : 0.0f;
+}
+
+// Value for the sprite shaders' "alphaCutoff" uniform: opaque draws discard
+// see-through texels so they can write depth without hiding what's behind
+inline float alphaCutoff(BlendMode mode)
+{
+	return mode == BlendMode::Opaque ? 0.5f : 0.0f;
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef RENDERTHREADH_H
+#define RENDERTHREADH_H
+
+#include <atomic>
+#include <thread>
+#include <SDL.h>
+
+#include "FramePacket.h"
+#include "SpscQueue.h"
+
+// Two packets: the update thread records frame N+1 while frame N is drawn
+static const size_t FRAME_PACKET_COUNT = 2;
+
+// Draws a packet and presents it, on whichever thread owns the context
+typedef void (*TRenderPacketFunc)(SDL_Window* w, FramePacket& packet);
+
+// Owns the GL context while running. Packets go round in a loop: the update
+// thread takes a free one from done, records into it and pushes it to ready;
+// the render thread draws it and pushes it back to done. Neither queue locks,
+// the waiting side backs off from spinning to short sleeps.
+struct RenderThread
+{
+	SDL_Window* window;
+	SDL_GLContext context;
+	TRenderPacketFunc renderPacket;
+
+	FramePacket packets[FRAME_PACKET_COUNT];
+	SpscQueue<FramePacket*, FRAME_PACKET_COUNT> ready; // Update -> render
+	SpscQueue<FramePacket*, FRAME_PACKET_COUNT> done;  // Render -> update
+
+	std::thread thread;
+	std::atomic<bool> stop;
+	bool threaded; // Off: submit draws the packet there and then
+
+	RenderThread();
+};
+
+// Releases the context from the caller and hands it to the new thread
+bool startRenderThread(RenderThread& renderer, SDL_Window* w, SDL_GLContext context, TRenderPacketFunc renderPacket, bool threaded);
+// Draws whatever is still queued, then makes the context current on the caller again
+void stopRenderThread(RenderThread& renderer);
+
+// Waits for a packet the render thread is done with. Its rendered flag and
+// stats describe the frame it last carried.
+FramePacket* acquireFramePacket(RenderThread& renderer);
+void submitFramePacket(RenderThread& renderer, FramePacket* packet);
+
+#endif
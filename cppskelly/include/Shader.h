@@ -5,15 +5,29 @@
 #include <glad\glad.h>
 #include <vector>
 #include <map>
+#include <cstdint>
+
+// KHR_parallel_shader_compile, not in our glad build
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
 class Shader
 {
 private:
 	GLuint mProgram;
 	GLuint mFrag, mVert;
 	std::vector<GLuint> mShaderIds;
+	uint64_t mCacheKey;
+	bool mUseCache;
+	bool mPending; // Compiled and linked, status not checked yet
 
 	void traceShaderLinkError(GLuint shaderId);
 	void traceShaderCompileError(GLuint shaderId);
+	bool loadProgramBinary(uint64_t key);
+	void saveProgramBinary(uint64_t key);
 
 public:
 	Shader();
@@ -24,11 +38,19 @@ public:
 	void bindAttributeLocation(GLuint index, const std::string &attribute);
 	void useProgram();
 
-	bool init(const char** filenames, GLenum* types, int numShaders);
+	// Sources go through preprocessShader with the given feature bits
+	bool init(const char** filenames, GLenum* types, int numShaders, uint32_t features = 0);
+	// init in two halves: begin submits the compile and link without waiting
+	// on them, finish checks the results. isReady says whether finish would
+	// block (always true without KHR_parallel_shader_compile).
+	bool begin(const char** filenames, GLenum* types, int numShaders, uint32_t features = 0);
+	bool isReady() const;
+	bool finish();
 	void cleanUp();
 
 	void registerUniform1i(const std::string& name,GLint value);
 	void registerUniform1f(const std::string& name, GLfloat value);
+	void registerUniform2f(const std::string& name, GLfloat x, GLfloat y);
 	void registerUniformMatrix4f(const std::string& name, GLfloat* matrix);
 
 	inline GLuint GetShaderID() const
@@ -42,4 +64,83 @@ typedef std::map<std::string, Shader>::iterator TShaderTableIter;
 
 extern TShaderTable gShaders;
 
+// Program name for a shader in gShaders, 0 if it isn't there
+GLuint findProgramID(const std::string& name);
+
+// Linked programs are saved with glGetProgramBinary under this directory
+// (ending in a separator) and reloaded by Shader::init when the sources and
+// the driver match. Empty disables the cache.
+void setShaderCacheDir(const std::string& dir);
+
+struct ShaderCacheStats
+{
+	int loaded;   // From the cache
+	int compiled; // From source, cache missing, stale or disabled
+};
+
+extern ShaderCacheStats gShaderCacheStats;
+
+// Turns on KHR_parallel_shader_compile if the driver has it
+bool initParallelShaderCompile(GLADloadproc loader);
+
+// Feature bits for shader variants. Each set bit is #defined in the variant's
+// sources, which test it with #ifdef, so a variant carries no code (and no
+// branches) for features it doesn't use.
+enum ShaderFeature : uint32_t
+{
+	SHADER_TEXTURED = 1 << 0,      // TEXTURED: sample the bound texture
+	SHADER_VERTEX_COLOUR = 1 << 1, // VERTEX_COLOUR: straight alpha colour per vertex
+	SHADER_ALPHA_TEST = 1 << 2,    // ALPHA_TEST: discard below alphaCutoff, for opaque draws
+	SHADER_PALETTED = 1 << 3,      // PALETTED: texture holds indexes into palette
+};
+
+static const int NUM_SHADER_FEATURES = 4;
+
+// Expands #include "file" (relative to the including file) and adds a #define
+// per feature bit after the #version line
+bool preprocessShader(const std::string& path, uint32_t features, std::string& source);
+
+// A family of variants built from the same sources
+struct ShaderProgramDesc
+{
+	std::vector<std::string> files;
+	std::vector<GLenum> types;
+	uint32_t features; // The bits its sources test, any others are dropped from requests
+};
+
+void registerShaderProgram(const std::string& program, const ShaderProgramDesc& desc);
+// Key in gShaders for a variant
+std::string shaderVariantName(const std::string& program, uint32_t features);
+
+struct ShaderRequest
+{
+	std::string program;
+	uint32_t features;
+};
+
+// Compiles the variants into gShaders. With parallel set every program is
+// submitted before any status is read, so the driver can compile them side
+// by side; otherwise each one is finished before the next starts.
+bool createShaders(const std::vector<ShaderRequest>& requests, bool parallel);
+
+// What a renderer last drew with, so the variant is only looked up again
+// when its program or features change
+struct ShaderVariantCache
+{
+	std::string program;
+	uint32_t features;
+	Shader* shader;
+
+	ShaderVariantCache() : program(), features(0), shader(nullptr) {}
+};
+
+// The variant, compiled on first use if startup didn't ask for it. nullptr
+// if it doesn't build.
+Shader* getShaderVariant(const std::string& program, uint32_t features, ShaderVariantCache& cache);
+inline GLuint getShaderVariantID(const std::string& program, uint32_t features, ShaderVariantCache& cache)
+{
+	Shader* shader = getShaderVariant(program, features, cache);
+	return shader != nullptr ? shader->GetShaderID() : 0;
+}
+
 #endif
\ No newline at end of file
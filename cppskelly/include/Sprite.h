@@ -9,13 +9,18 @@
 #include <glm/gtx/transform.hpp>
 
 #include "GeomUtils.h"
+#include "RenderState.h"
+#include "Shader.h"
+#include "SpriteHull.h"
+#include "Texture.h"
 #include "glad/glad.h"
 
 // Forget about batching for now
 static const int NUM_SPRITE_VBO = 2;
 extern const int NUM_SPRITE_VAO;
-static const int NUM_SPRITE_TRIANGLES_VERT_COUNT = 4;
-static const int NUM_SPRITE_TRIANGLES_IDX_COUNT = 6;
+// Room for a hull, a plain quad uses the first 4 vertices and 6 indexes
+static const int NUM_SPRITE_TRIANGLES_VERT_COUNT = SPRITE_HULL_MAX_VERTICES;
+static const int NUM_SPRITE_TRIANGLES_IDX_COUNT = SPRITE_HULL_MAX_INDEXES;
 extern const int SPRITE_VBO_ATTR_POS;
 extern const int SPRITE_VBO_ATTR_UV;
 
@@ -38,14 +43,18 @@ struct Sprite: public Drawable
 	glm::vec2 pivot;
 
 	//Render		
+	TextureHandle texHandle;
 	unsigned int texID;
-	unsigned int shaderID;
+	unsigned int paletteTexID; // 0 unless the texture is paletted
 	unsigned int samplerID;
-	glm::mat4 modelMatrix;
+	mutable ShaderVariantCache shaderVariant;
 
 	GLfloat vertices[NUM_SPRITE_TRIANGLES_VERT_COUNT][SPRITE_FLOATS_PER_VERTEX];
 	GLfloat uvs[NUM_SPRITE_TRIANGLES_VERT_COUNT][SPRITE_FLOATS_PER_UV];
 	GLuint indexes[NUM_SPRITE_TRIANGLES_IDX_COUNT];
+	int numIndexes;
+	SpriteHull hull; // Outline drawn instead of the quad, unit quad by default
+	Bounds2D localBounds; // Around the mesh, before pos/scale/angle
 	GLuint vaoID;
 	GLuint vboIDs[NUM_SPRITE_VBO];
 	GLuint eboID;
@@ -58,13 +67,16 @@ struct Sprite: public Drawable
 	float height;
 	float angle;
 
-	bool alphaBlend;
+	BlendMode blendMode;
 
 	Sprite(const std::string& name);
 	virtual ~Sprite();
 
 	void draw(SDL_Window* w, Camera* c) override;
 	void cleanup() override;
+	DrawSortInfo getSortInfo() const override;
+	bool getBounds(Bounds2D& bounds) const override;
+	bool getDrawData(DrawData& data) const override;
 
 	glm::vec2 velocity;
 	glm::vec2 acceleration;
@@ -73,6 +85,12 @@ struct Sprite: public Drawable
 
 void initSprite(Sprite& sprite, const std::string& texPath, const std::string& shaderName);
 void initSprite(Sprite& sprite, const std::string& texPath, const std::string& shaderName, float w, float h);
+glm::vec2 getPivotPoint(PivotType pivotType, float width, float height);
 void setPivotType(Sprite& sprite, PivotType pivotType, bool update = true);
 void setCustomPivot(Sprite& sprite, glm::vec2* pivot, bool update = true);
+bool setPaletteVariant(Sprite& sprite, int variant);
+// Traces the texture's alpha (inside clipRect if set) and draws the sprite
+// with the resulting hull from then on. maxVertices is capped at
+// SPRITE_HULL_MAX_VERTICES; false if clipRect isn't inside the texture.
+bool buildSpriteHull(Sprite& sprite, int maxVertices = SPRITE_HULL_MAX_VERTICES);
 #endif
\ No newline at end of file
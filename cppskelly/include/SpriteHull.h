@@ -0,0 +1,41 @@
+#ifndef SPRITEHULLH_H
+#define SPRITEHULLH_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "GeomUtils.h"
+
+static const int SPRITE_HULL_MAX_VERTICES = 8; // Also the per-frame stride of the sheets' hull table (hullPoints in sprite_anim.vert)
+static const int SPRITE_HULL_MAX_INDEXES = (SPRITE_HULL_MAX_VERTICES - 2) * 3;
+static const uint8_t SPRITE_HULL_ALPHA_THRESHOLD = 0;
+
+// Convex outline around a frame's visible texels, drawn instead of the full
+// quad so transparent corners aren't shaded. Points are counter-clockwise in
+// frame space: (0,0) is the frame's bottom left, (1,1) its top right. The hull
+// never leaves the frame, so its uvs can't reach into neighbouring frames.
+// Empty when the frame has no visible texels.
+struct SpriteHull
+{
+	std::vector<glm::vec2> points;
+	float coverage; // Hull area over quad area
+
+	SpriteHull() : points(), coverage(0.0f) {}
+};
+
+// The tracer reads every texel of the frame, so it must lie inside the image
+inline bool frameInsideImage(const Rect& frame, int width, int height)
+{
+	return frame.x >= 0.0f && frame.y >= 0.0f && frame.x + frame.w <= (float)width && frame.y + frame.h <= (float)height;
+}
+
+// pixels are RGBA8 rows, pitch bytes apart; frame is in texels from the top left
+void buildSpriteHull(const uint8_t* pixels, int pitch, const Rect& frame, int maxVertices, uint8_t alphaThreshold, SpriteHull& hull);
+void setUnitQuadHull(SpriteHull& hull);
+float polygonArea(const std::vector<glm::vec2>& points);
+
+// Triangle fan over a convex outline, returns the index count
+int buildHullIndexes(int numPoints, uint32_t* indexes);
+
+#endif
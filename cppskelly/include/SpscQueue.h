@@ -0,0 +1,44 @@
+#ifndef SPSCQUEUEH_H
+#define SPSCQUEUEH_H
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed size ring for one producer thread and one consumer thread, no locks.
+// Each side only writes its own index; the release store publishing it pairs
+// with the acquire load on the other side, so a popped item is fully written.
+template <typename T, size_t Capacity>
+struct SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+	T items[Capacity];
+	alignas(64) std::atomic<size_t> head; // Next to pop, written by the consumer
+	alignas(64) std::atomic<size_t> tail; // Next to push, written by the producer
+
+	SpscQueue() : head(0), tail(0) {}
+};
+
+// Producer side, false if full
+template <typename T, size_t Capacity>
+bool pushSpsc(SpscQueue<T, Capacity>& queue, const T& item)
+{
+	size_t tail = queue.tail.load(std::memory_order_relaxed);
+	if (tail - queue.head.load(std::memory_order_acquire) == Capacity) return false;
+	queue.items[tail & (Capacity - 1)] = item;
+	queue.tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+// Consumer side, false if empty
+template <typename T, size_t Capacity>
+bool popSpsc(SpscQueue<T, Capacity>& queue, T& item)
+{
+	size_t head = queue.head.load(std::memory_order_relaxed);
+	if (queue.tail.load(std::memory_order_acquire) == head) return false;
+	item = queue.items[head & (Capacity - 1)];
+	queue.head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+#endif
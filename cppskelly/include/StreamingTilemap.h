@@ -0,0 +1,107 @@
+#ifndef STREAMINGTILEMAPH_H
+#define STREAMINGTILEMAPH_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "glad/glad.h"
+#include "Drawable.h"
+#include "MappedFile.h"
+#include "RenderState.h"
+#include "Tilemap.h"
+
+// On-disk map: this header followed by chunksX * chunksY chunks in row-major
+// order, each chunkSize * chunkSize little endian uint16 tiles (row-major,
+// padded with TILE_EMPTY past the map edge). Every chunk sits in one
+// contiguous block so paging one in never touches its neighbours.
+struct TilemapFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t width; // tiles
+	uint32_t height;
+	uint32_t chunkSize;
+	uint32_t chunksX;
+	uint32_t chunksY;
+	uint32_t reserved;
+};
+
+static const uint32_t TILEMAP_FILE_VERSION = 1;
+
+bool writeTilemapFile(const std::string& path, int width, int height, const std::function<uint16_t(int, int)>& tileAt);
+
+// Vertex data built by the streaming thread, waiting for upload
+struct ChunkMesh
+{
+	uint32_t chunkIndex;
+	int numQuads;
+	std::vector<GLfloat> vertices;
+};
+
+struct SDL_Window;
+struct Camera;
+
+// Tilemap read from a memory mapped map file. Only the chunks around the
+// camera are resident; a background thread reads and meshes the ones about to
+// come into view (biased towards where the camera is heading) and far chunks
+// are released, so memory stays bounded however big the map is.
+struct StreamingTilemap : public Drawable
+{
+	std::string name;
+	std::string shaderName;
+	Tileset tileset;
+	unsigned int samplerID;
+	mutable ShaderVariantCache shaderVariant;
+	glm::vec2 tileSize; // world units
+	glm::vec2 origin;
+
+	MappedFile file;
+	TilemapFileHeader header;
+	GLuint eboID;
+	BlendMode blendMode;
+
+	std::unordered_map<uint32_t, TilemapChunk> resident;
+	std::vector<TilemapChunk> freeChunks; // GL objects kept for reuse
+
+	int prefetchMargin;     // chunks requested around the view
+	int lookahead;          // extra chunks requested in the direction of travel
+	int releaseMargin;      // hysteresis before a chunk is released
+	int maxUploadsPerFrame;
+	int maxFreeChunks;
+
+	glm::vec2 lastViewCentre;
+	bool hasLastView;
+
+	// Shared with the streaming thread, guarded by mutex
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<uint32_t> requests; // Most urgent first, rebuilt every frame
+	std::vector<ChunkMesh> ready;
+	uint32_t building;
+	bool stopWorker;
+
+	// Last frame's numbers
+	int visibleChunks;
+	int uploadedChunks;
+	int releasedChunks;
+
+	StreamingTilemap(const std::string& name);
+
+	void draw(SDL_Window* w, Camera* c) override;
+	void cleanup() override;
+	DrawSortInfo getSortInfo() const override;
+	bool getBounds(Bounds2D& bounds) const override;
+};
+
+bool initStreamingTilemap(StreamingTilemap& map, const std::string& mapPath, const std::string& texPath, const std::string& shaderName, int sheetTileWidth, int sheetTileHeight, const glm::vec2& tileSize);
+
+#endif
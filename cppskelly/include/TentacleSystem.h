@@ -0,0 +1,108 @@
+#ifndef TENTACLESYSTEMH_H
+#define TENTACLESYSTEMH_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "glad/glad.h"
+#include "Drawable.h"
+#include "RenderState.h"
+#include "Shader.h"
+
+// sin and cos of x together, polynomial after reducing to a quarter turn.
+// About 1e-7 absolute error for |x| up to a few thousand.
+void fastSinCos(float x, float& s, float& c);
+
+struct TentacleParams
+{
+	glm::vec2 a; // Root
+	glm::vec2 b; // Tip at rest
+	float controlSpeed;     // radians/s of the sway
+	float ratio1;           // Control points sit this far along ab...
+	float ratio2;
+	float controlAmplitude; // ...pushed this far off it
+	float width;            // At the root, tapers to the tip
+	uint32_t colour;        // 0xRRGGBBAA at the root, fades to the tip
+	float sideSpeed;        // radians/s of the tip's vertical bob
+	float sideAmplitude;
+	float startTime;
+};
+
+// Every tentacle in one place, one array per parameter. A simulation step
+// advances phases and control points four tentacles at a time; building the
+// geometry blends the last two steps' control points and writes the bezier
+// strips straight into one shared vertex buffer. Both are split over the job
+// threads and all the tentacles draw with a single call.
+struct TentacleSystem : public Drawable
+{
+	std::string name;
+	std::string shaderName;
+	BlendMode blendMode;
+	int numSteps; // Bezier segments per tentacle
+
+	// Parameters
+	std::vector<float> aX, aY, bX, bY;
+	std::vector<float> controlSpeed, sideSpeed;
+	std::vector<float> controlAmplitude, sideAmplitude;
+	std::vector<float> ratio1, ratio2;
+	std::vector<float> width;
+	std::vector<uint32_t> colour;
+
+	// State, phases kept within [-pi, pi] so the sincos stays accurate however long it runs
+	std::vector<float> controlPhase, sidePhase;
+	std::vector<float> tipY;
+	std::vector<float> control1X, control1Y, control2X, control2Y;
+	// The same at the step before, for interpolating
+	std::vector<float> prevTipY;
+	std::vector<float> prevControl1X, prevControl1Y, prevControl2X, prevControl2Y;
+
+	// Per step of the curve, shared by every tentacle
+	std::vector<glm::vec4> bezierWeights;
+	std::vector<float> widthScale;
+
+	// numSteps + 1 points per tentacle, each a +/- pair of xy vertices
+	std::vector<GLfloat> vertices;
+	Bounds2D bounds;
+
+	GLuint vaoID;
+	GLuint positionVboID;
+	GLuint colourVboID;
+	GLuint eboID;
+	size_t bufferedTentacles; // What the GL buffers were sized for
+	mutable ShaderVariantCache shaderVariant;
+
+	TentacleSystem(const std::string& name);
+
+	void draw(SDL_Window* w, Camera* c) override;
+	void cleanup() override;
+	DrawSortInfo getSortInfo() const override;
+	bool getBounds(Bounds2D& bounds) const override;
+	bool recordDraw(FramePacket& packet, PacketDraw& draw) override;
+	void drawRecorded(SDL_Window* w, Camera* c, const FramePacket& packet, const PacketDraw& draw) override;
+};
+
+void initTentacleSystem(TentacleSystem& system, int numSteps);
+size_t addTentacle(TentacleSystem& system, const TentacleParams& params);
+inline size_t getTentacleCount(const TentacleSystem& system)
+{
+	return system.aX.size();
+}
+inline size_t getTentacleVertexCount(const TentacleSystem& system)
+{
+	return 2 * (size_t)(system.numSteps + 1);
+}
+
+// (Re)creates the GL buffers for the current tentacles: call on the GL
+// thread after adding them and before the first draw
+bool buildTentacleBuffers(TentacleSystem& system);
+
+// One fixed simulation step for every tentacle, CPU only
+void stepTentacles(TentacleSystem& system, float dt);
+// Rebuilds the vertices alpha of the way from the previous step to the latest
+void buildTentacleGeometry(TentacleSystem& system, float alpha);
+// A step of dt and the geometry for it
+void updateTentacles(TentacleSystem& system, float dt);
+
+#endif
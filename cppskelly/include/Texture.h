@@ -1,9 +1,13 @@
 #ifndef TextureH_H
 #define TextureH_H
 #include <string>
+#include <vector>
 #include <map>
+#include <cstdint>
 #include <glad/glad.h>
 
+struct SDL_Surface;
+
 struct Texture
 {
 	std::string path;
@@ -12,16 +16,86 @@ struct Texture
 	unsigned int height;
 	int bpp;
 	GLenum texFormat;
+	uint64_t contentHash;
+	uint64_t contentCheck; // Second hash, confirms a contentHash match before sharing
+
+	// Indexed images keep the GL_R8 index texture in texID and their
+	// 256x1 RGBA palettes here. Entry 0 is the palette from the file, the
+	// rest are swaps added through addPaletteVariant.
+	bool paletted;
+	std::vector<unsigned int> paletteIDs;
 
 	void cleanUp();
 };
 
-typedef std::map<std::string, Texture> TTextureTable;
-typedef TTextureTable::iterator TTextureTableIter;
+static const int PALETTE_SIZE = 256;
+
+// Generational handle into the texture registry. Releasing a texture bumps the
+// slot's generation, so stale handles fail to resolve instead of aliasing
+// whatever gets loaded into the slot afterwards.
+struct TextureHandle
+{
+	static const uint32_t INVALID_INDEX = 0xffffffff;
+
+	uint32_t index;
+	uint32_t generation;
+
+	TextureHandle() : index(INVALID_INDEX), generation(0) {}
+	TextureHandle(uint32_t index, uint32_t generation) : index(index), generation(generation) {}
+
+	inline bool operator==(const TextureHandle& other) const
+	{
+		return index == other.index && generation == other.generation;
+	}
+	inline bool operator!=(const TextureHandle& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// Dense texture storage. Strings are only resolved at load time through
+// pathLookup; everything else should keep the handle around.
+// Images with identical contents share a single slot (and GL texture) even if
+// they were loaded from different paths.
+struct TextureRegistry
+{
+	std::vector<Texture> textures;
+	std::vector<uint32_t> generations;
+	std::vector<uint32_t> refCounts;
+	std::vector<uint32_t> freeSlots;
+
+	std::map<std::string, TextureHandle> pathLookup;
+	std::map<uint64_t, TextureHandle> contentLookup;
+};
+
+bool loadTexture(const std::string& fileName, TextureHandle& handle, TextureRegistry& registry);
+TextureHandle findTexture(const std::string& fileName, const TextureRegistry& registry);
+void releaseTexture(TextureHandle handle, TextureRegistry& registry);
+int addPaletteVariant(TextureHandle handle, const std::vector<uint32_t>& coloursRGBA, TextureRegistry& registry);
+void cleanupTextures(TextureRegistry& registry);
+
+// Decoded, premultiplied RGBA8 pixels (bytes in R, G, B, A order) for code that
+// builds its own GL textures. Free with SDL_FreeSurface.
+SDL_Surface* loadSurfaceRGBA(const std::string& fileName);
 
-bool loadTexture(const std::string& fileName, GLuint& texture, GLuint& width, GLuint& height, TTextureTable& table);
+// Starts decoding the images on worker threads so the main thread can get on
+// with GL work. loadTexture and loadSurfaceRGBA pick each result up (once)
+// instead of reading the file again. Call and consume from the GL thread.
+void prefetchTextures(const std::vector<std::string>& fileNames);
+
+inline bool isValid(TextureHandle handle, const TextureRegistry& registry)
+{
+	return handle.index < registry.generations.size()
+		&& registry.generations[handle.index] == handle.generation
+		&& registry.refCounts[handle.index] > 0;
+}
+
+inline const Texture* getTexture(TextureHandle handle, const TextureRegistry& registry)
+{
+	return isValid(handle, registry) ? &registry.textures[handle.index] : nullptr;
+}
 
-extern TTextureTable gTextures;
+extern TextureRegistry gTextures;
 
 
 #endif
@@ -0,0 +1,109 @@
+#ifndef TILEMAPH_H
+#define TILEMAPH_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "glad/glad.h"
+#include "Drawable.h"
+#include "RenderState.h"
+#include "Shader.h"
+#include "Texture.h"
+
+static const int TILEMAP_CHUNK_SIZE = 32; // Tiles per chunk side
+static const int TILEMAP_MAX_QUADS_PER_CHUNK = TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE;
+static const int TILEMAP_FLOATS_PER_VERTEX = 4; // pos.xy, uv.xy interleaved
+static const uint16_t TILE_EMPTY = 0xffff;
+
+extern const int TILEMAP_VBO_ATTR_POS;
+extern const int TILEMAP_VBO_ATTR_UV;
+
+struct SDL_Window;
+struct Camera;
+
+// Static geometry for TILEMAP_CHUNK_SIZE^2 tiles. GL objects are created the
+// first time the chunk is visible and only rebuilt after a tile edit.
+struct TilemapChunk
+{
+	GLuint vaoID;
+	GLuint vboID;
+	int numQuads;
+	bool dirty;
+
+	TilemapChunk() : vaoID(0), vboID(0), numQuads(0), dirty(true) {}
+};
+
+// Tile indexes count left to right, top to bottom across the tilesheet.
+// Tile (0,0) sits at origin and y grows upwards, like the camera.
+struct Tileset
+{
+	TextureHandle texHandle;
+	unsigned int texID;
+	unsigned int paletteTexID; // Non zero for an indexed tilesheet, texID then holds indexes
+	int texWidth;
+	int texHeight;
+	int tileWidth;  // texels
+	int tileHeight;
+	int columns;
+	int rows;
+};
+
+struct Tilemap : public Drawable
+{
+	std::string name;
+	std::string shaderName;
+	Tileset tileset;
+	unsigned int samplerID;
+	mutable ShaderVariantCache shaderVariant;
+
+	int width;  // tiles
+	int height;
+	glm::vec2 tileSize; // world units
+	glm::vec2 origin;
+
+	std::vector<uint16_t> tiles; // row-major, width * height
+
+	int chunksX;
+	int chunksY;
+	std::vector<TilemapChunk> chunks;
+	GLuint eboID; // Shared by all chunks: indexes for a full chunk
+
+	BlendMode blendMode;
+
+	// Last frame's numbers
+	int visibleChunks;
+	int rebuiltChunks;
+
+	Tilemap(const std::string& name);
+
+	void draw(SDL_Window* w, Camera* c) override;
+	void cleanup() override;
+	DrawSortInfo getSortInfo() const override;
+	bool getBounds(Bounds2D& bounds) const override;
+};
+
+bool initTileset(Tileset& tileset, const std::string& texPath, int tileWidth, int tileHeight);
+bool initTilemap(Tilemap& map, const std::string& texPath, const std::string& shaderName, int width, int height, int sheetTileWidth, int sheetTileHeight, const glm::vec2& tileSize);
+
+void setTile(Tilemap& map, int x, int y, uint16_t tile);
+uint16_t getTile(const Tilemap& map, int x, int y);
+void setTiles(Tilemap& map, const std::vector<uint16_t>& tiles);
+
+// Writes pos/uv quads for a block of tiles into out (appending) and returns how
+// many quads were emitted. tiles points at the block's first tile, rowStride is
+// the distance between rows. Empty tiles are skipped.
+int buildTileQuads(const uint16_t* tiles, int blockWidth, int blockHeight, int rowStride, const glm::vec2& blockOrigin, const glm::vec2& tileSize, const Tileset& tileset, std::vector<GLfloat>& out);
+
+// Variant for drawing chunks of the tileset with the blend mode
+uint32_t tilemapShaderFeatures(const Tileset& tileset, BlendMode blendMode);
+// Binds program, tilesheet and camera for drawing chunks, false if the shader is missing
+bool beginTilemapDraw(const std::string& shaderName, ShaderVariantCache& shaderVariant, const Tileset& tileset, unsigned int samplerID, BlendMode blendMode, Camera* c);
+
+GLuint createTileIndexBuffer();
+void uploadChunk(TilemapChunk& chunk, const std::vector<GLfloat>& vertices, int numQuads, GLuint eboID);
+void drawChunk(const TilemapChunk& chunk);
+void cleanupChunk(TilemapChunk& chunk);
+
+#endif
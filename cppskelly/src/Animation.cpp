@@ -0,0 +1,518 @@
+#include "Animation.h"
+#include "Camera.h"
+#include "FramePacket.h"
+#include "Shader.h"
+#include "Sprite.h"
+#include "logUtils.h"
+#include <SDL_surface.h>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <glm/gtc/type_ptr.hpp>
+
+const char* ANIMATED_SPRITE_SHADER_NAME = "sprites_animated";
+
+static const int ANIM_VBO_ATTR_POS = 0;
+static const int ANIM_VBO_ATTR_FRAME = 1;
+static const int FRAME_TABLE_BINDING = 0;
+static const int HULL_TABLE_BINDING = 1;
+
+SpriteSheet::SpriteSheet()
+	:name()
+	, texHandle()
+	, texID(0), texWidth(0), texHeight(0)
+	, frameTableID(0)
+	, hullPoints(), hullTableID(0)
+{}
+
+bool initSpriteSheet(SpriteSheet& sheet, const std::string& name, const std::string& texPath)
+{
+	sheet.name = name;
+	if (!loadTexture(texPath, sheet.texHandle, gTextures))
+	{
+		logError("SpriteSheet:: could not load the texture");
+		return false;
+	}
+
+	const Texture* tex = getTexture(sheet.texHandle, gTextures);
+	sheet.texID = tex->texID;
+	sheet.texWidth = tex->width;
+	sheet.texHeight = tex->height;
+	return true;
+}
+
+int addClip(SpriteSheet& sheet, const std::string& name, const std::vector<Rect>& frames, const std::vector<float>& durations, bool loop)
+{
+	if (frames.empty() || frames.size() != durations.size())
+	{
+		logError("SpriteSheet:: a clip needs one duration per frame");
+		return -1;
+	}
+	for (float duration : durations)
+	{
+		// Playback divides by the durations and the clip length
+		if (!(duration > 0.0f))
+		{
+			logError("SpriteSheet:: clip frame durations must be positive");
+			return -1;
+		}
+	}
+
+	AnimationClip clip;
+	clip.name = name;
+	clip.firstFrame = (uint32_t)sheet.frames.size();
+	clip.numFrames = (uint32_t)frames.size();
+	clip.loop = loop;
+	clip.length = 0.0f;
+	clip.uniformDuration = durations[0];
+	for (float duration : durations)
+	{
+		clip.length += duration;
+		clip.frameEnds.push_back(clip.length);
+		if (duration != clip.uniformDuration)
+		{
+			clip.uniformDuration = 0.0f;
+		}
+	}
+
+	sheet.frames.insert(sheet.frames.end(), frames.begin(), frames.end());
+	sheet.clips.push_back(clip);
+	return (int)sheet.clips.size() - 1;
+}
+
+int addGridClip(SpriteSheet& sheet, const std::string& name, int row, int firstColumn, int numFrames, int frameWidth, int frameHeight, float frameDuration, bool loop)
+{
+	std::vector<Rect> frames(numFrames);
+	for (int i = 0; i < numFrames; ++i)
+	{
+		frames[i].x = (float)((firstColumn + i) * frameWidth);
+		frames[i].y = (float)(row * frameHeight);
+		frames[i].w = (float)frameWidth;
+		frames[i].h = (float)frameHeight;
+	}
+	return addClip(sheet, name, frames, std::vector<float>(numFrames, frameDuration), loop);
+}
+
+int findClip(const SpriteSheet& sheet, const std::string& name)
+{
+	for (size_t i = 0; i < sheet.clips.size(); ++i)
+	{
+		if (sheet.clips[i].name == name) return (int)i;
+	}
+	return -1;
+}
+
+static void appendHull(std::vector<glm::vec2>& table, const SpriteHull& hull)
+{
+	// Repeated points turn the unused fan triangles into degenerates
+	glm::vec2 last = hull.points.empty() ? glm::vec2() : hull.points.back();
+	for (int i = 0; i < SPRITE_HULL_MAX_VERTICES; ++i)
+	{
+		table.push_back(i < (int)hull.points.size() ? hull.points[i] : last);
+	}
+}
+
+float buildSheetHulls(SpriteSheet& sheet, const std::string& texPath)
+{
+	SDL_Surface* surface = loadSurfaceRGBA(texPath);
+	if (surface == nullptr) return 1.0f;
+
+	sheet.hullPoints.clear();
+	float coverage = 0.0f;
+	SpriteHull hull;
+	for (const Rect& frame : sheet.frames)
+	{
+		if (frameInsideImage(frame, surface->w, surface->h))
+		{
+			buildSpriteHull((const uint8_t*)surface->pixels, surface->pitch, frame, SPRITE_HULL_MAX_VERTICES, SPRITE_HULL_ALPHA_THRESHOLD, hull);
+		}
+		else
+		{
+			logError("SpriteSheet:: frame is outside the texture, drawing it as a quad");
+			setUnitQuadHull(hull);
+		}
+		appendHull(sheet.hullPoints, hull);
+		coverage += hull.coverage;
+	}
+	SDL_FreeSurface(surface);
+
+	coverage = sheet.frames.empty() ? 1.0f : coverage / sheet.frames.size();
+	std::ostringstream sstream;
+	sstream << "SpriteSheet " << sheet.name << ": frame hulls cover " << (int)(coverage * 100.0f) << "% of their quads";
+	logInfo(sstream.str().c_str());
+	return coverage;
+}
+
+void uploadFrameTable(SpriteSheet& sheet)
+{
+	if (sheet.frames.empty() || sheet.texWidth == 0 || sheet.texHeight == 0) return;
+
+	if (sheet.hullPoints.size() != sheet.frames.size() * SPRITE_HULL_MAX_VERTICES)
+	{
+		SpriteHull quad;
+		setUnitQuadHull(quad);
+		sheet.hullPoints.clear();
+		for (size_t i = 0; i < sheet.frames.size(); ++i)
+		{
+			appendHull(sheet.hullPoints, quad);
+		}
+	}
+	if (sheet.hullTableID != 0)
+	{
+		glDeleteBuffers(1, &sheet.hullTableID);
+	}
+	glCreateBuffers(1, &sheet.hullTableID);
+	glNamedBufferStorage(sheet.hullTableID, sheet.hullPoints.size() * sizeof(glm::vec2), sheet.hullPoints.data(), 0);
+
+	std::vector<glm::vec4> uvs(sheet.frames.size());
+	for (size_t i = 0; i < sheet.frames.size(); ++i)
+	{
+		const Rect& r = sheet.frames[i];
+		uvs[i] = glm::vec4(r.x / sheet.texWidth, r.y / sheet.texHeight, (r.x + r.w) / sheet.texWidth, (r.y + r.h) / sheet.texHeight);
+	}
+
+	if (sheet.frameTableID != 0)
+	{
+		glDeleteBuffers(1, &sheet.frameTableID);
+	}
+	glCreateBuffers(1, &sheet.frameTableID);
+	glNamedBufferStorage(sheet.frameTableID, uvs.size() * sizeof(glm::vec4), uvs.data(), 0);
+}
+
+void cleanupSpriteSheet(SpriteSheet& sheet)
+{
+	glDeleteBuffers(1, &sheet.frameTableID);
+	glDeleteBuffers(1, &sheet.hullTableID);
+	sheet.frameTableID = 0;
+	sheet.hullTableID = 0;
+	releaseTexture(sheet.texHandle, gTextures);
+}
+
+AnimatedSpriteBatch::AnimatedSpriteBatch(const std::string& name)
+	:name(name)
+	, shaderName(ANIMATED_SPRITE_SHADER_NAME)
+	, sheet(nullptr)
+	, frameSize(1.0f, 1.0f), pivot()
+	, blendMode(BlendMode::Alpha)
+	, interpolated(false)
+	, ySort(false), drawOrder()
+	, cull(true), visibleList(), visibleFlags(), visibleInstances(0)
+	, instanceScratch()
+	, vaoID(0), instanceVboID(0), eboID(0), samplerID(0)
+	, instanceCapacity(0), shaderVariant()
+{}
+
+bool initAnimatedSpriteBatch(AnimatedSpriteBatch& batch, SpriteSheet* sheet, const glm::vec2& frameSize, PivotType pivotType)
+{
+	if (sheet == nullptr || sheet->frameTableID == 0)
+	{
+		logError("AnimatedSpriteBatch:: the sheet has no frame table, call uploadFrameTable first");
+		return false;
+	}
+
+	batch.sheet = sheet;
+	batch.frameSize = frameSize;
+	batch.pivot = getPivotPoint(pivotType, frameSize.x, frameSize.y);
+
+	// A fan over the frame's hull, the shader reads the points by vertex id
+	GLuint indexes[SPRITE_HULL_MAX_INDEXES];
+	buildHullIndexes(SPRITE_HULL_MAX_VERTICES, indexes);
+
+	glCreateVertexArrays(1, &batch.vaoID);
+	glCreateBuffers(1, &batch.eboID);
+	glCreateBuffers(1, &batch.instanceVboID);
+	glNamedBufferStorage(batch.eboID, sizeof(indexes), indexes, 0);
+	glVertexArrayElementBuffer(batch.vaoID, batch.eboID);
+
+	glVertexArrayVertexBuffer(batch.vaoID, 0, batch.instanceVboID, 0, sizeof(AnimatedInstance));
+	glVertexArrayBindingDivisor(batch.vaoID, 0, 1);
+	glEnableVertexArrayAttrib(batch.vaoID, ANIM_VBO_ATTR_POS);
+	glVertexArrayAttribFormat(batch.vaoID, ANIM_VBO_ATTR_POS, 2, GL_FLOAT, GL_FALSE, offsetof(AnimatedInstance, x));
+	glVertexArrayAttribBinding(batch.vaoID, ANIM_VBO_ATTR_POS, 0);
+	glEnableVertexArrayAttrib(batch.vaoID, ANIM_VBO_ATTR_FRAME);
+	glVertexArrayAttribIFormat(batch.vaoID, ANIM_VBO_ATTR_FRAME, 1, GL_UNSIGNED_INT, offsetof(AnimatedInstance, frame));
+	glVertexArrayAttribBinding(batch.vaoID, ANIM_VBO_ATTR_FRAME, 0);
+
+	glCreateSamplers(1, &batch.samplerID);
+	glSamplerParameteri(batch.samplerID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(batch.samplerID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glSamplerParameteri(batch.samplerID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(batch.samplerID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return true;
+}
+
+size_t addAnimatedSprite(AnimatedSpriteBatch& batch, const glm::vec2& pos, int clip, float speed, float startTime)
+{
+	if (clip < 0 || clip >= (int)batch.sheet->clips.size())
+	{
+		logError("AnimatedSpriteBatch:: no such clip in the sheet");
+		return NO_ANIMATED_SPRITE;
+	}
+
+	batch.posX.push_back(pos.x);
+	batch.posY.push_back(pos.y);
+	batch.prevPosX.push_back(pos.x);
+	batch.prevPosY.push_back(pos.y);
+	batch.drawPosX.push_back(pos.x);
+	batch.drawPosY.push_back(pos.y);
+	batch.clip.push_back((uint16_t)clip);
+	batch.time.push_back(startTime);
+	batch.speed.push_back(speed);
+	batch.frame.push_back(batch.sheet->clips[batch.clip.back()].firstFrame);
+	batch.sortLayer.push_back(0);
+	return batch.posX.size() - 1;
+}
+
+void playClip(AnimatedSpriteBatch& batch, size_t sprite, int clip)
+{
+	if (sprite >= batch.clip.size() || clip < 0 || clip >= (int)batch.sheet->clips.size()) return;
+	if (batch.clip[sprite] == clip) return;
+
+	batch.clip[sprite] = (uint16_t)clip;
+	batch.time[sprite] = 0.0f;
+	batch.frame[sprite] = batch.sheet->clips[clip].firstFrame;
+}
+
+void setSpriteLayer(AnimatedSpriteBatch& batch, size_t sprite, uint8_t layer)
+{
+	if (sprite >= batch.sortLayer.size()) return;
+	batch.sortLayer[sprite] = layer;
+}
+
+uint32_t advanceClip(const AnimationClip& clip, float& time, float dt)
+{
+	float t = time + dt;
+	if (clip.loop)
+	{
+		t = std::fmod(t, clip.length);
+		if (t < 0.0f) t += clip.length;
+	}
+	else
+	{
+		t = std::min(std::max(t, 0.0f), clip.length);
+	}
+	time = t;
+
+	uint32_t index;
+	if (clip.uniformDuration > 0.0f)
+	{
+		index = std::min((uint32_t)(t / clip.uniformDuration), clip.numFrames - 1);
+	}
+	else
+	{
+		index = 0;
+		while (index < clip.numFrames - 1 && t >= clip.frameEnds[index])
+		{
+			++index;
+		}
+	}
+	return clip.firstFrame + index;
+}
+
+void updateAnimations(AnimatedSpriteBatch& batch, float dt)
+{
+	const std::vector<AnimationClip>& clips = batch.sheet->clips;
+	const size_t count = batch.time.size();
+	float* time = batch.time.data();
+	const float* speed = batch.speed.data();
+	const uint16_t* clipIndexes = batch.clip.data();
+	uint32_t* frame = batch.frame.data();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		frame[i] = advanceClip(clips[clipIndexes[i]], time[i], dt * speed[i]);
+	}
+}
+
+void resizeAnimatedSprites(AnimatedSpriteBatch& batch, size_t count)
+{
+	batch.posX.resize(count);
+	batch.posY.resize(count);
+	batch.clip.resize(count);
+	batch.time.resize(count);
+	batch.speed.resize(count, 1.0f);
+	batch.frame.resize(count);
+	batch.sortLayer.resize(count);
+	batch.prevPosX.resize(count);
+	batch.prevPosY.resize(count);
+	batch.drawPosX.resize(count);
+	batch.drawPosY.resize(count);
+}
+
+void saveAnimatedSpritePositions(AnimatedSpriteBatch& batch)
+{
+	batch.prevPosX = batch.posX;
+	batch.prevPosY = batch.posY;
+}
+
+void interpolateAnimatedSprites(AnimatedSpriteBatch& batch, float alpha)
+{
+	const size_t count = batch.posX.size();
+	const float* posX = batch.posX.data();
+	const float* posY = batch.posY.data();
+	const float* prevX = batch.prevPosX.data();
+	const float* prevY = batch.prevPosY.data();
+	float* drawX = batch.drawPosX.data();
+	float* drawY = batch.drawPosY.data();
+	for (size_t i = 0; i < count; ++i)
+	{
+		drawX[i] = prevX[i] + (posX[i] - prevX[i]) * alpha;
+		drawY[i] = prevY[i] + (posY[i] - prevY[i]) * alpha;
+	}
+	batch.interpolated = true;
+}
+
+static uint32_t batchShaderFeatures(const AnimatedSpriteBatch& batch)
+{
+	return batch.blendMode == BlendMode::Opaque ? SHADER_TEXTURED | SHADER_ALPHA_TEST : SHADER_TEXTURED;
+}
+
+// Culls and orders the instances for this view, grown by cullMargin on every
+// side, into instances; returns how many
+static size_t buildInstances(AnimatedSpriteBatch& batch, Camera* c, float cullMargin, std::vector<AnimatedInstance>& instances)
+{
+	const size_t count = batch.posX.size();
+	const float* posX = batch.interpolated ? batch.drawPosX.data() : batch.posX.data();
+	const float* posY = batch.interpolated ? batch.drawPosY.data() : batch.posY.data();
+
+	// Pivot and frame size are shared, so growing the view by them turns the
+	// per-instance box test into a point test on the positions
+	Bounds2D view;
+	bool culling = batch.cull && getCullBounds(c, view);
+	size_t numVisible = count;
+	if (culling)
+	{
+		view.minPos += batch.pivot - batch.frameSize - cullMargin;
+		view.maxPos += batch.pivot + cullMargin;
+		batch.visibleList.resize(count);
+		numVisible = cullPointsSoA(posX, posY, count, view, batch.visibleList.data());
+	}
+	batch.visibleInstances = numVisible;
+	instances.resize(numVisible);
+	if (numVisible == 0) return 0;
+
+	const uint32_t* frame = batch.frame.data();
+	if (batch.ySort)
+	{
+		// Sort everything so the incremental order stays warm as sprites
+		// cross the view's edges
+		updateDrawOrder(batch.drawOrder, batch.sortLayer.data(), posY, count);
+		if (culling)
+		{
+			batch.visibleFlags.assign(count, 0);
+			for (size_t i = 0; i < numVisible; ++i)
+			{
+				batch.visibleFlags[batch.visibleList[i]] = 1;
+			}
+		}
+		const RenderQueueEntry* order = batch.drawOrder.entries.data();
+		size_t n = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t sprite = order[i].index;
+			if (culling && !batch.visibleFlags[sprite]) continue;
+			instances[n].x = posX[sprite];
+			instances[n].y = posY[sprite];
+			instances[n].frame = frame[sprite];
+			++n;
+		}
+	}
+	else if (culling)
+	{
+		for (size_t i = 0; i < numVisible; ++i)
+		{
+			uint32_t sprite = batch.visibleList[i];
+			instances[i].x = posX[sprite];
+			instances[i].y = posY[sprite];
+			instances[i].frame = frame[sprite];
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			instances[i].x = posX[i];
+			instances[i].y = posY[i];
+			instances[i].frame = frame[i];
+		}
+	}
+	return numVisible;
+}
+
+static void drawInstances(AnimatedSpriteBatch& batch, const AnimatedInstance* instances, size_t numInstances)
+{
+	Shader* shader = getShaderVariant(batch.shaderName, batchShaderFeatures(batch), batch.shaderVariant);
+	if (shader == nullptr)
+	{
+		logError("Shader not found!!");
+		return;
+	}
+
+	// The buffer only grows
+	if (numInstances > batch.instanceCapacity)
+	{
+		batch.instanceCapacity = std::max(numInstances, batch.instanceCapacity * 2);
+		glNamedBufferData(batch.instanceVboID, batch.instanceCapacity * sizeof(AnimatedInstance), nullptr, GL_STREAM_DRAW);
+	}
+	glNamedBufferSubData(batch.instanceVboID, 0, numInstances * sizeof(AnimatedInstance), instances);
+
+	const int TEX_UNIT = 0;
+	glBindTextureUnit(TEX_UNIT, batch.sheet->texID);
+	glBindSampler(TEX_UNIT, batch.samplerID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FRAME_TABLE_BINDING, batch.sheet->frameTableID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HULL_TABLE_BINDING, batch.sheet->hullTableID);
+
+	shader->registerUniform1i("texture", TEX_UNIT);
+	shader->registerUniform1f("additive", additiveFactor(batch.blendMode));
+	if (batch.blendMode == BlendMode::Opaque)
+	{
+		shader->registerUniform1f("alphaCutoff", alphaCutoff(batch.blendMode));
+	}
+	shader->registerUniform2f("frameSize", batch.frameSize.x, batch.frameSize.y);
+	shader->registerUniform2f("pivot", batch.pivot.x, batch.pivot.y);
+	shader->registerUniform1i("hullPoints", SPRITE_HULL_MAX_VERTICES);
+	shader->useProgram();
+	applyBlendMode(batch.blendMode);
+
+	glBindVertexArray(batch.vaoID);
+	glDrawElementsInstanced(GL_TRIANGLES, SPRITE_HULL_MAX_INDEXES, GL_UNSIGNED_INT, nullptr, (GLsizei)numInstances);
+}
+
+void AnimatedSpriteBatch::draw(SDL_Window* w, Camera* c)
+{
+	if (posX.empty() || sheet == nullptr) return;
+
+	size_t numVisible = buildInstances(*this, c, 0.0f, instanceScratch);
+	if (numVisible == 0) return;
+	drawInstances(*this, instanceScratch.data(), numVisible);
+}
+
+bool AnimatedSpriteBatch::recordDraw(FramePacket& packet, PacketDraw& draw)
+{
+	if (posX.empty() || sheet == nullptr) return false;
+
+	// A late-latched camera may draw slightly off the recorded one
+	size_t numVisible = buildInstances(*this, &packet.camera, packet.cullMargin, instanceScratch);
+	if (numVisible == 0) return false;
+	draw.dataSize = (uint32_t)(numVisible * sizeof(AnimatedInstance));
+	draw.dataOffset = appendPacketData(packet, instanceScratch.data(), draw.dataSize);
+	return true;
+}
+
+void AnimatedSpriteBatch::drawRecorded(SDL_Window* w, Camera* c, const FramePacket& packet, const PacketDraw& draw)
+{
+	drawInstances(*this, (const AnimatedInstance*)getPacketData(packet, draw), draw.dataSize / sizeof(AnimatedInstance));
+}
+
+void AnimatedSpriteBatch::cleanup()
+{
+	glDeleteBuffers(1, &instanceVboID);
+	glDeleteBuffers(1, &eboID);
+	glDeleteVertexArrays(1, &vaoID);
+	glDeleteSamplers(1, &samplerID);
+}
+
+DrawSortInfo AnimatedSpriteBatch::getSortInfo() const
+{
+	return DrawSortInfo{ layer, blendMode != BlendMode::Opaque, getShaderVariantID(shaderName, batchShaderFeatures(*this), shaderVariant), sheet != nullptr ? sheet->texID : 0, 0.0f };
+}
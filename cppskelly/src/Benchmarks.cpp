@@ -0,0 +1,310 @@
+#include "Benchmarks.h"
+#include "Culling.h"
+#include "DrawOrdering.h"
+#include "JobSystem.h"
+#include "Line.h"
+#include "TentacleSystem.h"
+#include "logUtils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <thread>
+
+typedef std::chrono::high_resolution_clock TBenchClock;
+
+struct SortScene
+{
+	std::vector<uint8_t> layers;
+	std::vector<float> y;
+	std::mt19937 rng;
+	float walk;
+	int teleportOdds;
+
+	SortScene(size_t count, float walk, int teleportOdds)
+		:layers(count), y(count), rng(1234), walk(walk), teleportOdds(teleportOdds)
+	{
+		std::uniform_real_distribution<float> pos(-5000.0f, 5000.0f);
+		for (size_t i = 0; i < count; ++i)
+		{
+			layers[i] = (uint8_t)(i % 3);
+			y[i] = pos(rng);
+		}
+	}
+
+	// Everything steps up to walk units, one in teleportOdds jumps anywhere
+	void step()
+	{
+		std::uniform_real_distribution<float> offset(-walk, walk);
+		std::uniform_real_distribution<float> pos(-5000.0f, 5000.0f);
+		std::uniform_int_distribution<int> teleport(0, teleportOdds - 1);
+		for (float& value : y)
+		{
+			value += teleport(rng) == 0 ? pos(rng) - value : offset(rng);
+		}
+	}
+};
+
+static void logResult(const char* name, double totalMs, int frames, const std::string& extra = std::string())
+{
+	std::ostringstream sstream;
+	sstream << "  " << name << ": " << totalMs / frames << " ms/frame" << extra;
+	logInfo(sstream.str().c_str());
+}
+
+static bool isOrdered(const std::vector<RenderQueueEntry>& entries)
+{
+	for (size_t i = 1; i < entries.size(); ++i)
+	{
+		if (entries[i - 1].key > entries[i].key) return false;
+	}
+	return true;
+}
+
+static void runDrawOrderScenario(size_t count, int frames, float walk, int teleportOdds)
+{
+	std::ostringstream header;
+	header << "Draw order benchmark: " << count << " items, " << frames << " frames, steps of " << walk << ", 1 in " << teleportOdds << " teleports";
+	logInfo(header.str().c_str());
+
+	// Every variant replays the same scene from the same seed
+	{
+		SortScene scene(count, walk, teleportOdds);
+		std::vector<RenderQueueEntry> entries(count);
+		double total = 0.0;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			scene.step();
+			TBenchClock::time_point start = TBenchClock::now();
+			for (size_t i = 0; i < count; ++i)
+			{
+				entries[i].index = (uint32_t)i;
+				entries[i].key = makeDrawOrderKey(scene.layers[i], scene.y[i]);
+			}
+			std::sort(entries.begin(), entries.end(), [](const RenderQueueEntry& a, const RenderQueueEntry& b) { return a.key < b.key; });
+			total += std::chrono::duration<double, std::milli>(TBenchClock::now() - start).count();
+		}
+		logResult("std::sort, from scratch", total, frames);
+	}
+
+	{
+		SortScene scene(count, walk, teleportOdds);
+		std::vector<RenderQueueEntry> entries(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			entries[i].index = (uint32_t)i;
+		}
+		double total = 0.0;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			scene.step();
+			TBenchClock::time_point start = TBenchClock::now();
+			for (RenderQueueEntry& entry : entries)
+			{
+				entry.key = makeDrawOrderKey(scene.layers[entry.index], scene.y[entry.index]);
+			}
+			std::sort(entries.begin(), entries.end(), [](const RenderQueueEntry& a, const RenderQueueEntry& b) { return a.key < b.key; });
+			total += std::chrono::duration<double, std::milli>(TBenchClock::now() - start).count();
+		}
+		logResult("std::sort, last frame's order", total, frames);
+	}
+
+	{
+		SortScene scene(count, walk, teleportOdds);
+		std::vector<RenderQueueEntry> entries(count);
+		std::vector<RenderQueueEntry> scratch;
+		double total = 0.0;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			scene.step();
+			TBenchClock::time_point start = TBenchClock::now();
+			for (size_t i = 0; i < count; ++i)
+			{
+				entries[i].index = (uint32_t)i;
+				entries[i].key = makeDrawOrderKey(scene.layers[i], scene.y[i]);
+			}
+			radixSortEntries(entries, scratch);
+			total += std::chrono::duration<double, std::milli>(TBenchClock::now() - start).count();
+		}
+		logResult("radix sort", total, frames);
+	}
+
+	{
+		SortScene scene(count, walk, teleportOdds);
+		DrawOrder order;
+		double total = 0.0;
+		int radixFrames = 0;
+		size_t shifts = 0;
+		bool ordered = true;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			scene.step();
+			TBenchClock::time_point start = TBenchClock::now();
+			updateDrawOrder(order, scene.layers.data(), scene.y.data(), count);
+			total += std::chrono::duration<double, std::milli>(TBenchClock::now() - start).count();
+
+			radixFrames += order.usedRadixSort;
+			shifts += order.shifts;
+			ordered = ordered && isOrdered(order.entries);
+		}
+		std::ostringstream extra;
+		extra << " (" << radixFrames << " radix fallbacks, " << shifts / frames << " shifts/frame" << (ordered ? "" : ", NOT ORDERED") << ")";
+		logResult("incremental DrawOrder", total, frames, extra.str());
+	}
+}
+
+void runDrawOrderBenchmark(size_t count, int frames)
+{
+	// Slow walkers, then a crowd that churns a lot more than a real scene would
+	runDrawOrderScenario(count, frames, 0.5f, 1000);
+	runDrawOrderScenario(count, frames, 2.0f, 100);
+}
+
+typedef size_t (*TCullFunction)(const BoundsSoA&, const Bounds2D&, uint32_t*);
+
+static size_t timeCulling(const char* name, TCullFunction cullFunction, const BoundsSoA& bounds, const Bounds2D& view, int iterations, std::vector<uint32_t>& visible)
+{
+	size_t numVisible = 0;
+	double total = 0.0;
+	for (int i = 0; i < iterations; ++i)
+	{
+		TBenchClock::time_point start = TBenchClock::now();
+		numVisible = cullFunction(bounds, view, visible.data());
+		total += std::chrono::duration<double, std::milli>(TBenchClock::now() - start).count();
+	}
+	std::ostringstream sstream;
+	sstream << "  " << name << ": " << total / iterations << " ms/pass, " << numVisible << " visible";
+	logInfo(sstream.str().c_str());
+	return numVisible;
+}
+
+void runCullingBenchmark(size_t count, int iterations)
+{
+	std::ostringstream header;
+	header << "Culling benchmark: " << count << " boxes, " << iterations << " passes";
+	logInfo(header.str().c_str());
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-5000.0f, 5000.0f);
+	std::uniform_real_distribution<float> size(1.0f, 64.0f);
+	BoundsSoA bounds;
+	for (size_t i = 0; i < count; ++i)
+	{
+		Bounds2D box;
+		box.minPos = glm::vec2(pos(rng), pos(rng));
+		box.maxPos = box.minPos + glm::vec2(size(rng), size(rng));
+		addBounds(bounds, box);
+	}
+	Bounds2D view;
+	view.minPos = glm::vec2(-2500.0f, -2500.0f);
+	view.maxPos = glm::vec2(2500.0f, 2500.0f);
+
+	std::vector<uint32_t> visible(count);
+	std::vector<uint32_t> visibleScalar(count);
+	size_t numScalar = timeCulling("scalar", cullBoundsScalar, bounds, view, iterations, visibleScalar);
+	size_t numSimd = timeCulling("SoA", cullBoundsSoA, bounds, view, iterations, visible);
+	if (numScalar != numSimd || !std::equal(visible.begin(), visible.begin() + numSimd, visibleScalar.begin()))
+	{
+		logError("  Culling results differ!!");
+	}
+}
+
+static double timeLineRebuilds(std::vector<LineRenderer>& lines, int frames)
+{
+	const int NUM_STEPS = 20;
+	TBenchClock::time_point start = TBenchClock::now();
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		float time = frame / 60.0f;
+		parallelFor(lines.size(), 16, [&lines, time](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				// Same curve the tentacles sweep, phase shifted per line
+				float phase = time * 3.0f + (float)i;
+				glm::vec2 a(0.0f, -300.0f);
+				glm::vec2 b(400.0f, 100.0f * std::sin(phase));
+				glm::vec2 control1(100.0f, 200.0f * std::cos(phase));
+				glm::vec2 control2(300.0f, -200.0f * std::cos(phase));
+				cubicBezier(a, b, control1, control2, lines[i], NUM_STEPS);
+			}
+		});
+	}
+	return std::chrono::duration<double, std::milli>(TBenchClock::now() - start).count();
+}
+
+void runJobBenchmark(size_t count, int frames)
+{
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	std::ostringstream header;
+	header << "Job benchmark: " << count << " lines rebuilt per frame, " << frames << " frames, up to " << maxThreads << " threads";
+	logInfo(header.str().c_str());
+
+	std::vector<LineRenderer> lines;
+	lines.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		lines.emplace_back("bench_" + std::to_string(i));
+		lines.back().lineWidth = 6.0f;
+		std::fill(std::begin(lines.back().colourRGBA), std::end(lines.back().colourRGBA), 1.0f);
+	}
+
+	double singleMs = 0.0;
+	for (int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+	{
+		initJobSystem(threads);
+		timeLineRebuilds(lines, 1); // Warm up the threads and the line buffers
+		double totalMs = timeLineRebuilds(lines, frames);
+		shutdownJobSystem();
+
+		if (threads == 1) singleMs = totalMs;
+		std::ostringstream extra;
+		extra << ", " << singleMs / totalMs << "x";
+		std::string name = std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+		logResult(name.c_str(), totalMs, frames, extra.str());
+		if (threads == maxThreads) break;
+	}
+}
+
+void runTentacleBenchmark(size_t count, int frames)
+{
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	std::ostringstream header;
+	header << "Tentacle benchmark: " << count << " tentacles updated per frame, " << frames << " frames, up to " << maxThreads << " threads";
+	logInfo(header.str().c_str());
+
+	TentacleSystem tentacles("bench_tentacles");
+	initTentacleSystem(tentacles, 20);
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (size_t i = 0; i < count; ++i)
+	{
+		glm::vec2 a(unit(rng) * 10000.0f, unit(rng) * 10000.0f);
+		float angle = unit(rng) * 6.2831853f;
+		glm::vec2 b = a + 450.0f * glm::vec2(std::cos(angle), std::sin(angle));
+		TentacleParams params = { a, b, 5.0f * (unit(rng) - 0.5f), 0.25f, 0.75f, 200.0f * unit(rng), 8.0f, 0x880fbbff, 5.5f, 25.0f, unit(rng) };
+		addTentacle(tentacles, params);
+	}
+
+	double singleMs = 0.0;
+	for (int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+	{
+		initJobSystem(threads);
+		updateTentacles(tentacles, 1 / 60.0f); // Warm up the threads
+		TBenchClock::time_point start = TBenchClock::now();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			updateTentacles(tentacles, 1 / 60.0f);
+		}
+		double totalMs = std::chrono::duration<double, std::milli>(TBenchClock::now() - start).count();
+		shutdownJobSystem();
+
+		if (threads == 1) singleMs = totalMs;
+		std::ostringstream extra;
+		extra << ", " << singleMs / totalMs << "x";
+		std::string name = std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+		logResult(name.c_str(), totalMs, frames, extra.str());
+		if (threads == maxThreads) break;
+	}
+}
@@ -1,5 +1,8 @@
 #include "Camera.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <cmath>
 
 void initOrtho(OrthoCamera* cam, const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up, const glm::vec4& borders, float zNear, float zFar)
 {
@@ -12,6 +15,8 @@ void initOrtho(OrthoCamera* cam, const glm::vec3& eye, const glm::vec3& target,
 	cam->bot = borders[3];
 	cam->zNear = zNear;
 	cam->zFar = zFar;
+	cam->viewDirty = true;
+	cam->projDirty = true;
 }
 
 void initPerspective(PerspectiveCamera* cam, const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up, float fov, float aspect, float zNear, float zFar)
@@ -23,20 +28,153 @@ void initPerspective(PerspectiveCamera* cam, const glm::vec3& eye, const glm::ve
 	cam->aspect = aspect;
 	cam->zNear = zNear;
 	cam->zFar = zFar;
+	cam->viewDirty = true;
+	cam->projDirty = true;
 }
 
-void updateCameraViewMatrix(Camera* cam)
+void setCameraLookAt(Camera* cam, const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up)
+{
+	cam->eye = eye;
+	cam->target = target;
+	cam->up = up;
+	cam->viewDirty = true;
+}
+
+void moveCamera(Camera* cam, const glm::vec3& delta)
+{
+	cam->eye += delta;
+	cam->target += delta;
+	cam->viewDirty = true;
+}
+
+void setOrthoBorders(OrthoCamera* cam, const glm::vec4& borders)
+{
+	cam->left = borders[0];
+	cam->right = borders[1];
+	cam->top = borders[2];
+	cam->bot = borders[3];
+	cam->projDirty = true;
+}
+
+void setPerspective(PerspectiveCamera* cam, float fov, float aspect)
+{
+	cam->fov = fov;
+	cam->aspect = aspect;
+	cam->projDirty = true;
+}
+
+static void buildViewMatrix(Camera* cam)
 {
 	cam->viewMatrix = glm::lookAt(cam->eye, cam->target, cam->up);
+	cam->viewDirty = false;
 }
 
-void updateCameraProjectionMatrix(PerspectiveCamera* cam)
+static void buildProjectionMatrix(PerspectiveCamera* cam)
 {
 	cam->projMatrix = glm::perspective(cam->fov, cam->aspect, cam->zNear, cam->zFar);
+	cam->projDirty = false;
 }
 
-void updateCameraProjectionMatrix(OrthoCamera* cam)
+static void buildProjectionMatrix(OrthoCamera* cam)
 {
 	cam->projMatrix = glm::ortho(cam->left, cam->right, cam->bot, cam->top, cam->zNear, cam->zFar);
+	cam->projDirty = false;
+}
+
+static void buildViewProjMatrix(Camera* cam)
+{
+	cam->viewProjMatrix = cam->projMatrix * cam->viewMatrix;
+	cam->invViewProjMatrix = glm::inverse(cam->viewProjMatrix);
+}
+
+template <typename TCamera>
+static bool updateDirtyMatrices(TCamera* cam)
+{
+	if (!cam->viewDirty && !cam->projDirty) return false;
+
+	if (cam->viewDirty) buildViewMatrix(cam);
+	if (cam->projDirty) buildProjectionMatrix(cam);
+	buildViewProjMatrix(cam);
+	return true;
+}
+
+bool updateCamera(OrthoCamera* cam)
+{
+	return updateDirtyMatrices(cam);
+}
+
+bool updateCamera(PerspectiveCamera* cam)
+{
+	return updateDirtyMatrices(cam);
 }
 
+void updateCameraViewMatrix(Camera* cam)
+{
+	buildViewMatrix(cam);
+	buildViewProjMatrix(cam);
+}
+
+void updateCameraProjectionMatrix(PerspectiveCamera* cam)
+{
+	buildProjectionMatrix(cam);
+	buildViewProjMatrix(cam);
+}
+
+void updateCameraProjectionMatrix(OrthoCamera* cam)
+{
+	buildProjectionMatrix(cam);
+	buildViewProjMatrix(cam);
+}
+
+bool getViewBounds(const Camera* cam, float planeZ, glm::vec2& minPos, glm::vec2& maxPos)
+{
+	const glm::mat4& invViewProj = cam->invViewProjMatrix;
+
+	bool found = false;
+	for (int i = 0; i < 4; ++i)
+	{
+		float ndcX = (i & 1) ? 1.0f : -1.0f;
+		float ndcY = (i & 2) ? 1.0f : -1.0f;
+
+		// Unproject the corner ray and intersect it with the plane
+		glm::vec4 nearPoint = invViewProj * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+		glm::vec4 farPoint = invViewProj * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+		glm::vec3 a = glm::vec3(nearPoint.x, nearPoint.y, nearPoint.z) / nearPoint.w;
+		glm::vec3 b = glm::vec3(farPoint.x, farPoint.y, farPoint.z) / farPoint.w;
+
+		glm::vec2 corner;
+		float dz = b.z - a.z;
+		if (std::abs(dz) < FLT_EPSILON)
+		{
+			// Ray parallel to the plane (ortho looking sideways): keep the near point
+			corner = glm::vec2(a.x, a.y);
+		}
+		else
+		{
+			float t = (planeZ - a.z) / dz;
+			if (t < 0.0f)
+			{
+				return false;
+			}
+			glm::vec3 p = a + (b - a) * t;
+			corner = glm::vec2(p.x, p.y);
+		}
+
+		if (!found)
+		{
+			minPos = maxPos = corner;
+			found = true;
+		}
+		else
+		{
+			minPos = glm::min(minPos, corner);
+			maxPos = glm::max(maxPos, corner);
+		}
+	}
+	return found;
+}
+
+bool getCullBounds(const Camera* cam, Bounds2D& bounds)
+{
+	return getViewBounds(cam, 0.0f, bounds.minPos, bounds.maxPos);
+}
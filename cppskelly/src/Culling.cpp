@@ -0,0 +1,159 @@
+#include "Culling.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CULLING_SSE2 1
+#include <emmintrin.h>
+#endif
+
+Bounds2D transformBounds(const Bounds2D& local, const glm::vec2& pos, const glm::vec2& scale, float angle)
+{
+	const float c = std::cos(angle);
+	const float s = std::sin(angle);
+	Bounds2D world;
+	for (int i = 0; i < 4; ++i)
+	{
+		glm::vec2 corner((i & 1) ? local.maxPos.x : local.minPos.x, (i & 2) ? local.maxPos.y : local.minPos.y);
+		corner *= scale;
+		glm::vec2 p(pos.x + corner.x * c - corner.y * s, pos.y + corner.x * s + corner.y * c);
+		if (i == 0)
+		{
+			world.minPos = world.maxPos = p;
+		}
+		else
+		{
+			world.minPos = glm::min(world.minPos, p);
+			world.maxPos = glm::max(world.maxPos, p);
+		}
+	}
+	return world;
+}
+
+bool computeBounds(const float* xy, size_t numPoints, Bounds2D& bounds)
+{
+	if (numPoints == 0) return false;
+
+	bounds.minPos = bounds.maxPos = glm::vec2(xy[0], xy[1]);
+	for (size_t i = 1; i < numPoints; ++i)
+	{
+		glm::vec2 p(xy[i * 2], xy[i * 2 + 1]);
+		bounds.minPos = glm::min(bounds.minPos, p);
+		bounds.maxPos = glm::max(bounds.maxPos, p);
+	}
+	return true;
+}
+
+void clearBounds(BoundsSoA& bounds)
+{
+	bounds.minX.clear();
+	bounds.minY.clear();
+	bounds.maxX.clear();
+	bounds.maxY.clear();
+}
+
+void addBounds(BoundsSoA& bounds, const Bounds2D& box)
+{
+	bounds.minX.push_back(box.minPos.x);
+	bounds.minY.push_back(box.minPos.y);
+	bounds.maxX.push_back(box.maxPos.x);
+	bounds.maxY.push_back(box.maxPos.y);
+}
+
+size_t cullBoundsScalar(const BoundsSoA& bounds, const Bounds2D& view, uint32_t* visible)
+{
+	size_t numVisible = 0;
+	for (size_t i = 0; i < bounds.minX.size(); ++i)
+	{
+		if (bounds.minX[i] <= view.maxPos.x && bounds.maxX[i] >= view.minPos.x
+			&& bounds.minY[i] <= view.maxPos.y && bounds.maxY[i] >= view.minPos.y)
+		{
+			visible[numVisible++] = (uint32_t)i;
+		}
+	}
+	return numVisible;
+}
+
+#ifdef CULLING_SSE2
+// Per 4 bit lane mask: the set lanes' offsets packed to the front, and how many there are
+static const int32_t LANE_OFFSETS[16][4] =
+{
+	{ 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 },
+	{ 2, 0, 0, 0 }, { 0, 2, 0, 0 }, { 1, 2, 0, 0 }, { 0, 1, 2, 0 },
+	{ 3, 0, 0, 0 }, { 0, 3, 0, 0 }, { 1, 3, 0, 0 }, { 0, 1, 3, 0 },
+	{ 2, 3, 0, 0 }, { 0, 2, 3, 0 }, { 1, 2, 3, 0 }, { 0, 1, 2, 3 }
+};
+static const int LANE_COUNTS[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// Appends the lanes set in mask with one 16 byte store; the count only
+// advances past the visible ones. Writes up to first + 3, which is never
+// past the last box tested.
+static inline size_t appendLanes(uint32_t* visible, size_t numVisible, uint32_t first, int mask)
+{
+	const __m128i offsets = _mm_loadu_si128((const __m128i*)LANE_OFFSETS[mask]);
+	_mm_storeu_si128((__m128i*)(visible + numVisible), _mm_add_epi32(_mm_set1_epi32((int)first), offsets));
+	return numVisible + LANE_COUNTS[mask];
+}
+#endif
+
+size_t cullBoundsSoA(const BoundsSoA& bounds, const Bounds2D& view, uint32_t* visible)
+{
+	const size_t count = bounds.minX.size();
+	size_t numVisible = 0;
+	size_t i = 0;
+#ifdef CULLING_SSE2
+	const __m128 viewMinX = _mm_set1_ps(view.minPos.x);
+	const __m128 viewMinY = _mm_set1_ps(view.minPos.y);
+	const __m128 viewMaxX = _mm_set1_ps(view.maxPos.x);
+	const __m128 viewMaxY = _mm_set1_ps(view.maxPos.y);
+	const float* minX = bounds.minX.data();
+	const float* minY = bounds.minY.data();
+	const float* maxX = bounds.maxX.data();
+	const float* maxY = bounds.maxY.data();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 inside = _mm_and_ps(
+			_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minX + i), viewMaxX), _mm_cmpge_ps(_mm_loadu_ps(maxX + i), viewMinX)),
+			_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minY + i), viewMaxY), _mm_cmpge_ps(_mm_loadu_ps(maxY + i), viewMinY)));
+		numVisible = appendLanes(visible, numVisible, (uint32_t)i, _mm_movemask_ps(inside));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		if (bounds.minX[i] <= view.maxPos.x && bounds.maxX[i] >= view.minPos.x
+			&& bounds.minY[i] <= view.maxPos.y && bounds.maxY[i] >= view.minPos.y)
+		{
+			visible[numVisible++] = (uint32_t)i;
+		}
+	}
+	return numVisible;
+}
+
+size_t cullPointsSoA(const float* x, const float* y, size_t count, const Bounds2D& view, uint32_t* visible)
+{
+	size_t numVisible = 0;
+	size_t i = 0;
+#ifdef CULLING_SSE2
+	const __m128 viewMinX = _mm_set1_ps(view.minPos.x);
+	const __m128 viewMinY = _mm_set1_ps(view.minPos.y);
+	const __m128 viewMaxX = _mm_set1_ps(view.maxPos.x);
+	const __m128 viewMaxY = _mm_set1_ps(view.maxPos.y);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i);
+		__m128 py = _mm_loadu_ps(y + i);
+		__m128 inside = _mm_and_ps(
+			_mm_and_ps(_mm_cmpge_ps(px, viewMinX), _mm_cmple_ps(px, viewMaxX)),
+			_mm_and_ps(_mm_cmpge_ps(py, viewMinY), _mm_cmple_ps(py, viewMaxY)));
+		numVisible = appendLanes(visible, numVisible, (uint32_t)i, _mm_movemask_ps(inside));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		if (x[i] >= view.minPos.x && x[i] <= view.maxPos.x && y[i] >= view.minPos.y && y[i] <= view.maxPos.y)
+		{
+			visible[numVisible++] = (uint32_t)i;
+		}
+	}
+	return numVisible;
+}
@@ -0,0 +1,118 @@
+#include "DrawOrdering.h"
+#include <algorithm>
+
+DrawOrder::DrawOrder()
+	:entries(), scratch()
+	, maxShiftsPerItem(8.0f)
+	, shifts(0), usedRadixSort(false)
+{}
+
+void resetDrawOrder(DrawOrder& order)
+{
+	order.entries.clear();
+}
+
+// An item that would have to travel further than this jumped rather than
+// drifted: it's pulled out and merged back in afterwards
+static const size_t MAX_LOCAL_SHIFT = 32;
+
+// Insertion sort for the items that drifted, merge for the ones that jumped.
+// Returns false once the work gets close to a full sort, leaving entries
+// unsorted but complete.
+static bool incrementalSort(DrawOrder& order, size_t maxShifts, size_t maxDisplaced)
+{
+	std::vector<RenderQueueEntry>& entries = order.entries;
+	std::vector<RenderQueueEntry>& displaced = order.scratch;
+	displaced.clear();
+
+	RenderQueueEntry* data = entries.data();
+	const size_t count = entries.size();
+	size_t sorted = 0; // entries[0, sorted) are in order
+	size_t shifts = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		RenderQueueEntry entry = data[i];
+		// Jumped forward: keeping it would push everything after it out of place.
+		// Entries ahead of i haven't been moved yet, so this compares against
+		// last frame's order.
+		size_t ahead = std::min(i + MAX_LOCAL_SHIFT, count - 1);
+		bool jumped = entry.key > data[ahead].key;
+
+		size_t j = sorted;
+		while (!jumped && j > 0 && data[j - 1].key > entry.key && sorted - j < MAX_LOCAL_SHIFT)
+		{
+			--j;
+		}
+		if (jumped || (j > 0 && data[j - 1].key > entry.key))
+		{
+			displaced.push_back(entry);
+			if (displaced.size() > maxDisplaced) break;
+			continue;
+		}
+
+		for (size_t k = sorted; k > j; --k)
+		{
+			data[k] = data[k - 1];
+		}
+		data[j] = entry;
+		shifts += sorted - j;
+		++sorted;
+		if (shifts > maxShifts) break;
+	}
+	order.shifts = shifts;
+
+	if (sorted + displaced.size() < count)
+	{
+		// Gave up part way: put the pulled out items back so nothing is lost
+		std::copy(displaced.begin(), displaced.end(), data + sorted);
+		return false;
+	}
+
+	// Merge from the back so the sorted run can stay where it is
+	std::sort(displaced.begin(), displaced.end(), [](const RenderQueueEntry& a, const RenderQueueEntry& b) { return a.key < b.key; });
+	size_t out = count;
+	size_t left = sorted;
+	size_t right = displaced.size();
+	while (right > 0)
+	{
+		if (left > 0 && data[left - 1].key > displaced[right - 1].key)
+		{
+			data[--out] = data[--left];
+		}
+		else
+		{
+			data[--out] = displaced[--right];
+		}
+	}
+	return true;
+}
+
+void updateDrawOrder(DrawOrder& order, const uint8_t* layers, const float* y, size_t count)
+{
+	order.shifts = 0;
+	order.usedRadixSort = false;
+
+	// New or removed items: no useful order to start from
+	bool rebuild = order.entries.size() != count;
+	if (rebuild)
+	{
+		order.entries.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			order.entries[i].index = (uint32_t)i;
+		}
+	}
+
+	for (RenderQueueEntry& entry : order.entries)
+	{
+		entry.key = makeDrawOrderKey(layers[entry.index], y[entry.index]);
+	}
+
+	if (!rebuild && incrementalSort(order, (size_t)(count * order.maxShiftsPerItem), count / 16))
+	{
+		return;
+	}
+
+	radixSortEntries(order.entries, order.scratch);
+	order.usedRadixSort = true;
+}
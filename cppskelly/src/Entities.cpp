@@ -0,0 +1,219 @@
+#include "Entities.h"
+#include "JobSystem.h"
+#include "logUtils.h"
+#include <cstring>
+
+static const uint32_t ENTITY_INDEX_BITS = 24;
+static const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+
+static const size_t COMPONENT_SIZES[NUM_COMPONENT_TYPES] =
+{
+	sizeof(Position),
+	sizeof(PreviousPosition),
+	sizeof(Velocity),
+	sizeof(AnimationState),
+	sizeof(SpriteInstance),
+	sizeof(Walker),
+	sizeof(PlayerControl)
+};
+
+static EntityID makeEntityID(uint32_t index, uint8_t generation)
+{
+	return index | ((uint32_t)generation << ENTITY_INDEX_BITS);
+}
+
+EntityChunk::EntityChunk()
+	:mask(0), count(0)
+	, entities(), components()
+{}
+
+EntityWorld::EntityWorld()
+	:archetypes(), records()
+	, freeRecords(), numEntities(0)
+{}
+
+static uint32_t findArchetype(EntityWorld& world, ComponentMask mask)
+{
+	for (size_t i = 0; i < world.archetypes.size(); ++i)
+	{
+		if (world.archetypes[i].mask == mask) return (uint32_t)i;
+	}
+	Archetype archetype;
+	archetype.mask = mask;
+	world.archetypes.push_back(archetype);
+	return (uint32_t)(world.archetypes.size() - 1);
+}
+
+// A zeroed row at the end of the archetype's last chunk
+static void allocateRow(EntityWorld& world, uint32_t archetypeIndex, EntityID entity, EntityRecord& record)
+{
+	Archetype& archetype = world.archetypes[archetypeIndex];
+	if (archetype.chunks.empty() || archetype.chunks.back().count == ENTITY_CHUNK_CAPACITY)
+	{
+		archetype.chunks.emplace_back();
+		EntityChunk& chunk = archetype.chunks.back();
+		chunk.mask = archetype.mask;
+		chunk.entities.resize(ENTITY_CHUNK_CAPACITY);
+		for (int type = 0; type < NUM_COMPONENT_TYPES; ++type)
+		{
+			if (chunk.mask & componentBit((ComponentType)type))
+			{
+				chunk.components[type].resize(ENTITY_CHUNK_CAPACITY * COMPONENT_SIZES[type]);
+			}
+		}
+	}
+
+	EntityChunk& chunk = archetype.chunks.back();
+	size_t row = chunk.count++;
+	chunk.entities[row] = entity;
+	for (int type = 0; type < NUM_COMPONENT_TYPES; ++type)
+	{
+		if (!chunk.components[type].empty())
+		{
+			memset(&chunk.components[type][row * COMPONENT_SIZES[type]], 0, COMPONENT_SIZES[type]);
+		}
+	}
+	record.archetype = archetypeIndex;
+	record.chunk = (uint32_t)(archetype.chunks.size() - 1);
+	record.row = (uint32_t)row;
+}
+
+// Fills the hole with the archetype's very last entity, then drops empty chunks
+static void freeRow(EntityWorld& world, const EntityRecord& record)
+{
+	Archetype& archetype = world.archetypes[record.archetype];
+	EntityChunk& chunk = archetype.chunks[record.chunk];
+	EntityChunk& lastChunk = archetype.chunks.back();
+	size_t lastRow = lastChunk.count - 1;
+	if (&chunk != &lastChunk || record.row != lastRow)
+	{
+		for (int type = 0; type < NUM_COMPONENT_TYPES; ++type)
+		{
+			if (chunk.components[type].empty()) continue;
+			memcpy(&chunk.components[type][record.row * COMPONENT_SIZES[type]], &lastChunk.components[type][lastRow * COMPONENT_SIZES[type]], COMPONENT_SIZES[type]);
+		}
+		EntityID moved = lastChunk.entities[lastRow];
+		chunk.entities[record.row] = moved;
+		EntityRecord& movedRecord = world.records[moved & ENTITY_INDEX_MASK];
+		movedRecord.chunk = record.chunk;
+		movedRecord.row = record.row;
+	}
+	if (--lastChunk.count == 0)
+	{
+		archetype.chunks.pop_back();
+	}
+}
+
+EntityID createEntity(EntityWorld& world, ComponentMask mask)
+{
+	uint32_t index;
+	if (!world.freeRecords.empty())
+	{
+		index = world.freeRecords.back();
+		world.freeRecords.pop_back();
+	}
+	else
+	{
+		if (world.records.size() >= ENTITY_INDEX_MASK) // The last index would collide with INVALID_ENTITY
+		{
+			logError("EntityWorld:: out of entity IDs");
+			return INVALID_ENTITY;
+		}
+		index = (uint32_t)world.records.size();
+		world.records.push_back(EntityRecord{ 0, 0, 0, 0, false });
+	}
+
+	EntityRecord& record = world.records[index];
+	EntityID entity = makeEntityID(index, record.generation);
+	allocateRow(world, findArchetype(world, mask), entity, record);
+	record.alive = true;
+	++world.numEntities;
+	return entity;
+}
+
+bool isEntityAlive(const EntityWorld& world, EntityID entity)
+{
+	uint32_t index = entity & ENTITY_INDEX_MASK;
+	if (entity == INVALID_ENTITY || index >= world.records.size()) return false;
+
+	const EntityRecord& record = world.records[index];
+	return record.alive && makeEntityID(index, record.generation) == entity;
+}
+
+void destroyEntity(EntityWorld& world, EntityID entity)
+{
+	if (!isEntityAlive(world, entity)) return;
+
+	uint32_t index = entity & ENTITY_INDEX_MASK;
+	EntityRecord& record = world.records[index];
+	freeRow(world, record);
+	record.alive = false;
+	++record.generation;
+	world.freeRecords.push_back(index);
+	--world.numEntities;
+}
+
+ComponentMask getEntityComponents(const EntityWorld& world, EntityID entity)
+{
+	if (!isEntityAlive(world, entity)) return 0;
+	return world.archetypes[world.records[entity & ENTITY_INDEX_MASK].archetype].mask;
+}
+
+void setEntityComponents(EntityWorld& world, EntityID entity, ComponentMask mask)
+{
+	if (!isEntityAlive(world, entity)) return;
+
+	EntityRecord& record = world.records[entity & ENTITY_INDEX_MASK];
+	if (world.archetypes[record.archetype].mask == mask) return;
+
+	EntityRecord from = record;
+	allocateRow(world, findArchetype(world, mask), entity, record);
+	// Both archetypes may have grown a chunk, fetch them only now
+	EntityChunk& source = world.archetypes[from.archetype].chunks[from.chunk];
+	EntityChunk& target = world.archetypes[record.archetype].chunks[record.chunk];
+	for (int type = 0; type < NUM_COMPONENT_TYPES; ++type)
+	{
+		if (source.components[type].empty() || target.components[type].empty()) continue;
+		memcpy(&target.components[type][record.row * COMPONENT_SIZES[type]], &source.components[type][from.row * COMPONENT_SIZES[type]], COMPONENT_SIZES[type]);
+	}
+	freeRow(world, from);
+}
+
+void* getComponentData(EntityWorld& world, EntityID entity, ComponentType type)
+{
+	if (!isEntityAlive(world, entity)) return nullptr;
+
+	const EntityRecord& record = world.records[entity & ENTITY_INDEX_MASK];
+	EntityChunk& chunk = world.archetypes[record.archetype].chunks[record.chunk];
+	if (chunk.components[type].empty()) return nullptr;
+	return &chunk.components[type][record.row * COMPONENT_SIZES[type]];
+}
+
+void queryChunks(EntityWorld& world, ComponentMask required, std::vector<EntityChunk*>& chunks)
+{
+	chunks.clear();
+	for (Archetype& archetype : world.archetypes)
+	{
+		if ((archetype.mask & required) != required) continue;
+		for (EntityChunk& chunk : archetype.chunks)
+		{
+			if (chunk.count > 0)
+			{
+				chunks.push_back(&chunk);
+			}
+		}
+	}
+}
+
+void forEachChunk(EntityWorld& world, ComponentMask required, const std::function<void(EntityChunk& chunk)>& body)
+{
+	std::vector<EntityChunk*> chunks;
+	queryChunks(world, required, chunks);
+	parallelFor(chunks.size(), 1, [&chunks, &body](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			body(*chunks[i]);
+		}
+	});
+}
@@ -0,0 +1,96 @@
+#include "EntitySystems.h"
+#include "Animation.h"
+#include "JobSystem.h"
+#include <cstring>
+
+void updatePlayerControl(EntityWorld& world, const glm::vec2& axis)
+{
+	forEachChunk(world, componentBit(COMPONENT_PLAYER_CONTROL) | componentBit(COMPONENT_VELOCITY), [&axis](EntityChunk& chunk)
+	{
+		const PlayerControl* control = getChunkComponents<PlayerControl>(chunk);
+		Velocity* velocity = getChunkComponents<Velocity>(chunk);
+		for (size_t i = 0; i < chunk.count; ++i)
+		{
+			velocity[i].x = axis.x * control[i].speed;
+			velocity[i].y = axis.y * control[i].speed;
+		}
+	});
+}
+
+void updateMovement(EntityWorld& world, float dt)
+{
+	forEachChunk(world, componentBit(COMPONENT_POSITION) | componentBit(COMPONENT_VELOCITY), [dt](EntityChunk& chunk)
+	{
+		Position* position = getChunkComponents<Position>(chunk);
+		const Velocity* velocity = getChunkComponents<Velocity>(chunk);
+		if (chunkHas(chunk, COMPONENT_PREVIOUS_POSITION))
+		{
+			static_assert(sizeof(Position) == sizeof(PreviousPosition), "Position and PreviousPosition must match");
+			memcpy(getChunkComponents<PreviousPosition>(chunk), position, chunk.count * sizeof(Position));
+		}
+		for (size_t i = 0; i < chunk.count; ++i)
+		{
+			position[i].x += velocity[i].x * dt;
+			position[i].y += velocity[i].y * dt;
+		}
+	});
+}
+
+void updateEntityAnimations(EntityWorld& world, const SpriteSheet& sheet, float dt)
+{
+	const std::vector<AnimationClip>& clips = sheet.clips;
+	forEachChunk(world, componentBit(COMPONENT_ANIMATION), [&clips, dt](EntityChunk& chunk)
+	{
+		AnimationState* animation = getChunkComponents<AnimationState>(chunk);
+		for (size_t i = 0; i < chunk.count; ++i)
+		{
+			animation[i].frame = advanceClip(clips[animation[i].clip], animation[i].time, dt * animation[i].speed);
+		}
+	});
+}
+
+void extractSpriteInstances(EntityWorld& world, AnimatedSpriteBatch& batch, float alpha)
+{
+	std::vector<EntityChunk*> chunks;
+	queryChunks(world, componentBit(COMPONENT_POSITION) | componentBit(COMPONENT_ANIMATION) | componentBit(COMPONENT_SPRITE_INSTANCE), chunks);
+
+	// Each chunk writes its own range of the batch
+	std::vector<size_t> offsets(chunks.size() + 1, 0);
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		offsets[i + 1] = offsets[i] + chunks[i]->count;
+	}
+	resizeAnimatedSprites(batch, offsets.back());
+	batch.interpolated = false; // The positions written below already are
+
+	parallelFor(chunks.size(), 1, [&chunks, &offsets, &batch, alpha](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; ++c)
+		{
+			EntityChunk& chunk = *chunks[c];
+			const Position* position = getChunkComponents<Position>(chunk);
+			const PreviousPosition* previous = chunkHas(chunk, COMPONENT_PREVIOUS_POSITION) ? getChunkComponents<PreviousPosition>(chunk) : nullptr;
+			const AnimationState* animation = getChunkComponents<AnimationState>(chunk);
+			const SpriteInstance* instance = getChunkComponents<SpriteInstance>(chunk);
+			float* posX = batch.posX.data() + offsets[c];
+			float* posY = batch.posY.data() + offsets[c];
+			uint32_t* frame = batch.frame.data() + offsets[c];
+			uint8_t* sortLayer = batch.sortLayer.data() + offsets[c];
+			for (size_t i = 0; i < chunk.count; ++i)
+			{
+				if (previous != nullptr)
+				{
+					posX[i] = previous[i].x + (position[i].x - previous[i].x) * alpha;
+					posY[i] = previous[i].y + (position[i].y - previous[i].y) * alpha;
+				}
+				else
+				{
+					posX[i] = position[i].x;
+					posY[i] = position[i].y;
+				}
+				frame[i] = animation[i].frame;
+				sortLayer[i] = instance[i].sortLayer;
+			}
+		}
+	});
+}
@@ -0,0 +1,43 @@
+#include "FixedTimestep.h"
+#include <algorithm>
+
+// Anything longer is a stall (breakpoint, window drag), not a frame
+static const double MAX_FRAME_SECONDS = 0.25;
+
+FixedTimestep::FixedTimestep()
+	:stepSeconds(1.0 / 60.0)
+	, accumulator(0.0)
+	, maxStepsPerFrame(5)
+	, steps(0), droppedSteps(0)
+{}
+
+void initFixedTimestep(FixedTimestep& timestep, double hz, int maxStepsPerFrame)
+{
+	timestep.stepSeconds = 1.0 / std::max(hz, 1.0);
+	timestep.accumulator = 0.0;
+	timestep.maxStepsPerFrame = std::max(maxStepsPerFrame, 1);
+	timestep.steps = 0;
+	timestep.droppedSteps = 0;
+}
+
+int advanceFixedTimestep(FixedTimestep& timestep, double frameSeconds)
+{
+	timestep.accumulator += std::min(std::max(frameSeconds, 0.0), MAX_FRAME_SECONDS);
+	int numSteps = (int)(timestep.accumulator / timestep.stepSeconds);
+	timestep.accumulator -= numSteps * timestep.stepSeconds;
+
+	// Under load the simulation slows down instead of falling further behind
+	// by taking ever more steps per frame
+	if (numSteps > timestep.maxStepsPerFrame)
+	{
+		timestep.droppedSteps += numSteps - timestep.maxStepsPerFrame;
+		numSteps = timestep.maxStepsPerFrame;
+	}
+	timestep.steps += numSteps;
+	return numSteps;
+}
+
+float getInterpolationAlpha(const FixedTimestep& timestep)
+{
+	return (float)std::min(timestep.accumulator / timestep.stepSeconds, 1.0);
+}
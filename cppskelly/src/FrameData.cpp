@@ -0,0 +1,105 @@
+#include "FrameData.h"
+#include "Camera.h"
+#include "logUtils.h"
+#include <algorithm>
+#include <glm/gtx/transform.hpp>
+
+FrameData gFrameData;
+
+static const size_t MIN_DRAW_DATA_CAPACITY = 256;
+
+static void resizeDrawBuffers(FrameData& frame, size_t capacity)
+{
+	// Same buffer names, new storage, so VAOs pointing at the ids stay valid
+	std::vector<uint32_t> ids(capacity);
+	for (size_t i = 0; i < capacity; ++i)
+	{
+		ids[i] = (uint32_t)i;
+	}
+	glNamedBufferData(frame.drawIdVboID, capacity * sizeof(uint32_t), ids.data(), GL_STATIC_DRAW);
+	glNamedBufferData(frame.drawDataID, capacity * sizeof(DrawData), nullptr, GL_STREAM_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_SSBO_BINDING, frame.drawDataID);
+	frame.capacity = capacity;
+}
+
+bool initFrameData(FrameData& frame)
+{
+	glCreateBuffers(1, &frame.uboID);
+	glCreateBuffers(1, &frame.drawDataID);
+	glCreateBuffers(1, &frame.drawIdVboID);
+	if (frame.uboID == 0 || frame.drawDataID == 0 || frame.drawIdVboID == 0)
+	{
+		logError("Frame data buffer creation failed");
+		return false;
+	}
+	glNamedBufferStorage(frame.uboID, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, frame.uboID);
+
+	resizeDrawBuffers(frame, MIN_DRAW_DATA_CAPACITY);
+	clearDrawData(frame);
+	uploadDrawData(frame);
+	return true;
+}
+
+void cleanupFrameData(FrameData& frame)
+{
+	glDeleteBuffers(1, &frame.uboID);
+	glDeleteBuffers(1, &frame.drawDataID);
+	glDeleteBuffers(1, &frame.drawIdVboID);
+	frame.uboID = frame.drawDataID = frame.drawIdVboID = 0;
+	frame.capacity = 0;
+	frame.draws.clear();
+}
+
+void publishFrameUniforms(FrameData& frame, const Camera* cam, float time, int viewportWidth, int viewportHeight)
+{
+	FrameUniforms uniforms;
+	uniforms.view = cam->viewMatrix;
+	uniforms.proj = cam->projMatrix;
+	uniforms.viewProj = cam->viewProjMatrix;
+	uniforms.invViewProj = cam->invViewProjMatrix;
+	uniforms.viewport = glm::vec4(0.0f, 0.0f, (float)viewportWidth, (float)viewportHeight);
+	uniforms.time = time;
+	glNamedBufferSubData(frame.uboID, 0, sizeof(FrameUniforms), &uniforms);
+}
+
+void clearDrawData(FrameData& frame)
+{
+	frame.draws.clear();
+	frame.draws.push_back(DrawData{ glm::mat4(1.0f) });
+}
+
+uint32_t addDrawData(FrameData& frame, const DrawData& data)
+{
+	frame.draws.push_back(data);
+	return (uint32_t)(frame.draws.size() - 1);
+}
+
+void uploadDrawData(FrameData& frame)
+{
+	if (frame.draws.size() > frame.capacity)
+	{
+		resizeDrawBuffers(frame, std::max(frame.draws.size(), frame.capacity * 2));
+	}
+	glNamedBufferSubData(frame.drawDataID, 0, frame.draws.size() * sizeof(DrawData), frame.draws.data());
+}
+
+void enableDrawIDAttribute(const FrameData& frame)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, frame.drawIdVboID);
+	glVertexAttribIPointer(DRAW_ID_ATTR, 1, GL_UNSIGNED_INT, 0, 0);
+	glVertexAttribDivisor(DRAW_ID_ATTR, 1);
+	glEnableVertexAttribArray(DRAW_ID_ATTR);
+}
+
+void setDefaultDrawID()
+{
+	glVertexAttribI4ui(DRAW_ID_ATTR, 0, 0, 0, 0);
+}
+
+glm::mat4 buildModelMatrix(const glm::vec2& pos, float angle, const glm::vec2& scale)
+{
+	return glm::translate(glm::vec3(pos.x, pos.y, 0.0f))
+		* glm::rotate(angle, glm::vec3(0.0f, 0.0f, 1.0f))
+		* glm::scale(glm::vec3(scale.x, scale.y, 1.0f));
+}
@@ -0,0 +1,200 @@
+#include "FramePacing.h"
+#include "logUtils.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Starting guess for a 1 ms sleep's real length until we've timed a few
+static const double DEFAULT_SLEEP_SECONDS = 0.002;
+static const int MIN_SLEEP_SAMPLES = 8;
+// Keep learning, but don't let one descheduled sleep dominate forever
+static const uint64_t MAX_SLEEP_SAMPLES = 1000;
+// When the display won't say
+static const int DEFAULT_REFRESH_HZ = 60;
+
+static double secondsBetween(TPacingClock::time_point from, TPacingClock::time_point to)
+{
+	return std::chrono::duration<double>(to - from).count();
+}
+
+FrameTimeStats::FrameTimeStats()
+	:count(0), mean(0.0), m2(0.0)
+	, min(DBL_MAX), max(0.0)
+{}
+
+void addFrameTime(FrameTimeStats& stats, double seconds)
+{
+	++stats.count;
+	double delta = seconds - stats.mean;
+	stats.mean += delta / stats.count;
+	stats.m2 += delta * (seconds - stats.mean);
+	stats.min = std::min(stats.min, seconds);
+	stats.max = std::max(stats.max, seconds);
+}
+
+double getFrameTimeStdDev(const FrameTimeStats& stats)
+{
+	return stats.count > 1 ? std::sqrt(stats.m2 / (stats.count - 1)) : 0.0;
+}
+
+void resetFrameTimeStats(FrameTimeStats& stats)
+{
+	stats = FrameTimeStats();
+}
+
+FramePacer::FramePacer()
+	:vsync(VsyncMode::On)
+	, targetSeconds(0.0)
+	, nextFrame()
+	, vsyncLeadSeconds(0.0)
+	, refreshSeconds(1.0 / DEFAULT_REFRESH_HZ)
+	, lastPresent()
+	, sleepTimes(), frameTimes(), swapTimes()
+{}
+
+VsyncMode setVsyncMode(FramePacer& pacer, VsyncMode mode)
+{
+	if (SDL_GL_SetSwapInterval((int)mode) != 0)
+	{
+		if (mode == VsyncMode::Adaptive)
+		{
+			logInfo("Adaptive vsync not supported, using vsync");
+			return setVsyncMode(pacer, VsyncMode::On);
+		}
+		logError("Couldn't set the swap interval");
+		mode = (VsyncMode)SDL_GL_GetSwapInterval();
+	}
+	pacer.vsync = mode;
+	return mode;
+}
+
+bool parseVsyncMode(const char* name, VsyncMode& mode)
+{
+	std::string value(name);
+	if (value == "off") mode = VsyncMode::Off;
+	else if (value == "on") mode = VsyncMode::On;
+	else if (value == "adaptive") mode = VsyncMode::Adaptive;
+	else return false;
+	return true;
+}
+
+const char* getVsyncModeName(VsyncMode mode)
+{
+	switch (mode)
+	{
+	case VsyncMode::Off: return "off";
+	case VsyncMode::Adaptive: return "adaptive";
+	default: return "on";
+	}
+}
+
+void setFrameCap(FramePacer& pacer, double fps)
+{
+	pacer.targetSeconds = fps > 0.0 ? 1.0 / fps : 0.0;
+	pacer.nextFrame = TPacingClock::now();
+}
+
+static double getSleepEstimate(const FrameTimeStats& sleepTimes)
+{
+	if (sleepTimes.count < MIN_SLEEP_SAMPLES) return DEFAULT_SLEEP_SECONDS;
+	return sleepTimes.mean + getFrameTimeStdDev(sleepTimes);
+}
+
+static void sleepUntil(FramePacer& pacer, TPacingClock::time_point deadline)
+{
+	// Whole sleeps while even a slow one would wake before the deadline
+	TPacingClock::time_point now = TPacingClock::now();
+	while (secondsBetween(now, deadline) > getSleepEstimate(pacer.sleepTimes))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		TPacingClock::time_point woke = TPacingClock::now();
+		if (pacer.sleepTimes.count >= MAX_SLEEP_SAMPLES)
+		{
+			resetFrameTimeStats(pacer.sleepTimes);
+		}
+		addFrameTime(pacer.sleepTimes, secondsBetween(now, woke));
+		now = woke;
+	}
+
+	// The rest is shorter than a sleep can be trusted with
+	while (TPacingClock::now() < deadline)
+	{
+		// Spin
+	}
+}
+
+void waitForNextFrame(FramePacer& pacer)
+{
+	if (pacer.targetSeconds <= 0.0) return;
+
+	TPacingClock::duration target = std::chrono::duration_cast<TPacingClock::duration>(std::chrono::duration<double>(pacer.targetSeconds));
+	pacer.nextFrame += target;
+	TPacingClock::time_point now = TPacingClock::now();
+	if (pacer.nextFrame < now)
+	{
+		// Late: start counting again from here rather than rushing the
+		// following frames to catch up
+		pacer.nextFrame = now;
+		return;
+	}
+	sleepUntil(pacer, pacer.nextFrame);
+}
+
+void setRefreshRate(FramePacer& pacer, int hz)
+{
+	pacer.refreshSeconds = 1.0 / (hz > 0 ? hz : DEFAULT_REFRESH_HZ);
+}
+
+void notePresent(FramePacer& pacer, TPacingClock::time_point presentTime)
+{
+	pacer.lastPresent = std::max(pacer.lastPresent, presentTime);
+}
+
+void waitForVsyncLead(FramePacer& pacer)
+{
+	if (pacer.vsyncLeadSeconds <= 0.0 || pacer.vsync == VsyncMode::Off || pacer.lastPresent == TPacingClock::time_point()) return;
+
+	// Swaps return right after a vsync, so they step forward from the last one
+	TPacingClock::time_point now = TPacingClock::now();
+	double sinceLead = secondsBetween(pacer.lastPresent, now) + pacer.vsyncLeadSeconds;
+	double refreshes = std::ceil(sinceLead / pacer.refreshSeconds);
+	double untilStart = refreshes * pacer.refreshSeconds - sinceLead;
+	if (untilStart <= 0.0) return;
+
+	sleepUntil(pacer, now + std::chrono::duration_cast<TPacingClock::duration>(std::chrono::duration<double>(untilStart)));
+}
+
+double swapWindowTimed(SDL_Window* w)
+{
+	TPacingClock::time_point start = TPacingClock::now();
+	SDL_GL_SwapWindow(w);
+	return secondsBetween(start, TPacingClock::now());
+}
+
+void logFramePacing(FramePacer& pacer)
+{
+	const FrameTimeStats& frames = pacer.frameTimes;
+	const FrameTimeStats& swaps = pacer.swapTimes;
+	if (frames.count == 0) return;
+
+	std::ostringstream sstream;
+	sstream << "Frames: " << frames.count << ", " << frames.mean * 1000.0 << " ms mean (" << 1.0 / frames.mean << " fps), "
+		<< getFrameTimeStdDev(frames) * 1000.0 << " ms std dev, " << frames.min * 1000.0 << "-" << frames.max * 1000.0 << " ms, vsync "
+		<< getVsyncModeName(pacer.vsync);
+	if (pacer.targetSeconds > 0.0)
+	{
+		sstream << ", capped at " << 1.0 / pacer.targetSeconds << " fps";
+	}
+	logInfo(sstream.str().c_str());
+	if (swaps.count > 0)
+	{
+		sstream.str("");
+		sstream << "Swap blocked " << swaps.mean * 1000.0 << " ms mean, " << swaps.max * 1000.0 << " ms max";
+		logInfo(sstream.str().c_str());
+	}
+	resetFrameTimeStats(pacer.frameTimes);
+	resetFrameTimeStats(pacer.swapTimes);
+}
@@ -0,0 +1,74 @@
+#include "FramePacket.h"
+#include <cstring>
+
+// Payloads start 16 byte aligned so vertex data can be read in place
+static const size_t PACKET_DATA_ALIGNMENT = 16;
+
+FramePacket::FramePacket()
+	:frame(0)
+	, camera(), time(0.0f)
+	, viewportWidth(0), viewportHeight(0)
+	, depthPrepass(false)
+	, lateLatch(false), cullMargin(0.0f), inputTime()
+	, latencyProbe(NO_LATENCY_PROBE), submitTime()
+	, draws(), data(), culled(0)
+	, rendered(false), stats(), fragments(0)
+	, swapSeconds(0.0), presentTime()
+	, latchGainSeconds(0.0), gpuDoneTime()
+{}
+
+void beginFramePacket(FramePacket& packet, uint64_t frame, const OrthoCamera& camera, float time, int viewportWidth, int viewportHeight)
+{
+	// Buffers keep their capacity, a steady scene stops allocating after a few frames
+	packet.frame = frame;
+	packet.camera = camera;
+	packet.time = time;
+	packet.viewportWidth = viewportWidth;
+	packet.viewportHeight = viewportHeight;
+	packet.draws.clear();
+	packet.data.clear();
+	packet.culled = 0;
+	packet.lateLatch = false;
+	packet.cullMargin = 0.0f;
+	packet.inputTime = TPacingClock::now();
+	packet.latencyProbe = NO_LATENCY_PROBE;
+	packet.rendered = false;
+}
+
+void recordFramePacket(FramePacket& packet, const std::vector<Drawable*>& drawables, bool cull)
+{
+	Bounds2D view;
+	bool culling = cull && getCullBounds(&packet.camera, view);
+	view.minPos -= packet.cullMargin;
+	view.maxPos += packet.cullMargin;
+	for (Drawable* drawable : drawables)
+	{
+		Bounds2D bounds;
+		if (culling && drawable->getBounds(bounds) && !isVisible(view, bounds))
+		{
+			++packet.culled;
+			continue;
+		}
+
+		PacketDraw draw;
+		draw.drawable = drawable;
+		draw.hasDrawData = drawable->getDrawData(draw.drawData);
+		draw.dataOffset = 0;
+		draw.dataSize = 0;
+		if (drawable->recordDraw(packet, draw))
+		{
+			packet.draws.push_back(draw);
+		}
+	}
+}
+
+uint32_t appendPacketData(FramePacket& packet, const void* src, size_t size)
+{
+	size_t offset = (packet.data.size() + PACKET_DATA_ALIGNMENT - 1) & ~(PACKET_DATA_ALIGNMENT - 1);
+	packet.data.resize(offset + size);
+	if (size > 0)
+	{
+		memcpy(packet.data.data() + offset, src, size);
+	}
+	return (uint32_t)offset;
+}
@@ -0,0 +1,15 @@
+#include "GLUtils.h"
+#include "glad/glad.h"
+#include <cstring>
+
+bool hasGLExtension(const char* name)
+{
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; ++i)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != nullptr && strcmp(extension, name) == 0) return true;
+	}
+	return false;
+}
@@ -0,0 +1,77 @@
+#include "GpuStats.h"
+#include "GLUtils.h"
+#include "logUtils.h"
+
+FragmentCounter::FragmentCounter()
+	:current(0)
+	, target(GL_SAMPLES_PASSED)
+	, active(false)
+	, lastCount(0)
+{
+	for (int i = 0; i < GPU_QUERY_FRAMES; ++i)
+	{
+		queries[i] = 0;
+		pending[i] = false;
+	}
+}
+
+bool initFragmentCounter(FragmentCounter& counter)
+{
+	if (hasGLExtension("GL_ARB_pipeline_statistics_query"))
+	{
+		counter.target = GL_FRAGMENT_SHADER_INVOCATIONS_ARB;
+		logInfo("Counting fragment shader invocations");
+	}
+	else
+	{
+		counter.target = GL_SAMPLES_PASSED;
+		logInfo("No pipeline statistics queries, counting samples passed instead");
+	}
+	glCreateQueries(counter.target, GPU_QUERY_FRAMES, counter.queries);
+	return true;
+}
+
+static void collectResults(FragmentCounter& counter)
+{
+	for (int i = 0; i < GPU_QUERY_FRAMES; ++i)
+	{
+		if (!counter.pending[i]) continue;
+
+		GLuint available = 0;
+		glGetQueryObjectuiv(counter.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue;
+
+		glGetQueryObjectui64v(counter.queries[i], GL_QUERY_RESULT, &counter.lastCount);
+		counter.pending[i] = false;
+	}
+}
+
+void beginFragmentCount(FragmentCounter& counter)
+{
+	if (counter.queries[0] == 0) return;
+
+	collectResults(counter);
+	// Still in flight after GPU_QUERY_FRAMES frames: skip this one rather than wait
+	if (counter.pending[counter.current]) return;
+
+	glBeginQuery(counter.target, counter.queries[counter.current]);
+	counter.active = true;
+}
+
+void endFragmentCount(FragmentCounter& counter)
+{
+	if (!counter.active) return;
+
+	glEndQuery(counter.target);
+	counter.active = false;
+	counter.pending[counter.current] = true;
+	counter.current = (counter.current + 1) % GPU_QUERY_FRAMES;
+}
+
+void cleanupFragmentCounter(FragmentCounter& counter)
+{
+	if (counter.queries[0] == 0) return;
+
+	glDeleteQueries(GPU_QUERY_FRAMES, counter.queries);
+	counter = FragmentCounter();
+}
@@ -0,0 +1,180 @@
+#include "GpuTilemap.h"
+#include "Camera.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "logUtils.h"
+#include <SDL_surface.h>
+#include <sstream>
+#include <glm/gtc/type_ptr.hpp>
+
+const char* GPU_TILEMAP_SHADER_NAME = "tilemap_gpu";
+
+static const int INDEX_TEX_UNIT = 0;
+static const int TILE_ARRAY_TEX_UNIT = 1;
+
+GpuTilemap::GpuTilemap(const std::string& name)
+	:name(name)
+	, shaderName(GPU_TILEMAP_SHADER_NAME)
+	, width(0), height(0)
+	, tileSize(1.0f, 1.0f), origin()
+	, tileTexelWidth(0), tileTexelHeight(0), numLayers(0)
+	, indexTexID(0), tileArrayTexID(0), vaoID(0), shaderVariant()
+	, blendMode(BlendMode::Opaque)
+{}
+
+bool initGpuTilemap(GpuTilemap& map, const std::vector<std::string>& sheetPaths, int tileWidth, int tileHeight, int width, int height, const glm::vec2& tileSize)
+{
+	std::vector<SDL_Surface*> sheets;
+	map.sheetFirstLayer.clear();
+	map.numLayers = 0;
+	for (const std::string& path : sheetPaths)
+	{
+		// Tile indexes are laid out in sheetPaths order, skipping a sheet would shift every later one
+		SDL_Surface* sheet = loadSurfaceRGBA(path);
+		if (sheet == nullptr)
+		{
+			logError("GpuTilemap:: a tilesheet failed to load");
+			for (SDL_Surface* loaded : sheets)
+			{
+				SDL_FreeSurface(loaded);
+			}
+			map.sheetFirstLayer.clear();
+			map.numLayers = 0;
+			return false;
+		}
+		map.sheetFirstLayer.push_back(map.numLayers);
+		map.numLayers += (sheet->w / tileWidth) * (sheet->h / tileHeight);
+		sheets.push_back(sheet);
+	}
+
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if (map.numLayers == 0 || map.numLayers > maxLayers || map.numLayers >= GPU_TILE_EMPTY)
+	{
+		std::ostringstream sstream;
+		sstream << "GpuTilemap:: can't build a tile array with " << map.numLayers << " layers (max " << maxLayers << ")";
+		logError(sstream.str().c_str());
+		for (SDL_Surface* sheet : sheets)
+		{
+			SDL_FreeSurface(sheet);
+		}
+		return false;
+	}
+
+	map.tileTexelWidth = tileWidth;
+	map.tileTexelHeight = tileHeight;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &map.tileArrayTexID);
+	glTextureStorage3D(map.tileArrayTexID, 1, GL_RGBA8, tileWidth, tileHeight, map.numLayers);
+	glTextureParameteri(map.tileArrayTexID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(map.tileArrayTexID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(map.tileArrayTexID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(map.tileArrayTexID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// One layer per tile, read straight out of the sheet with the unpack row length
+	int layer = 0;
+	for (SDL_Surface* sheet : sheets)
+	{
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, sheet->pitch / 4);
+		int columns = sheet->w / tileWidth;
+		int rows = sheet->h / tileHeight;
+		for (int row = 0; row < rows; ++row)
+		{
+			for (int column = 0; column < columns; ++column)
+			{
+				const Uint8* first = (const Uint8*)sheet->pixels + (size_t)row * tileHeight * sheet->pitch + (size_t)column * tileWidth * 4;
+				glTextureSubImage3D(map.tileArrayTexID, 0, 0, 0, layer, tileWidth, tileHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, first);
+				++layer;
+			}
+		}
+		SDL_FreeSurface(sheet);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	map.width = width;
+	map.height = height;
+	map.tileSize = tileSize;
+	glCreateTextures(GL_TEXTURE_2D, 1, &map.indexTexID);
+	glTextureStorage2D(map.indexTexID, 1, GL_R16UI, width, height);
+	glTextureParameteri(map.indexTexID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(map.indexTexID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	std::vector<uint16_t> empty((size_t)width * height, GPU_TILE_EMPTY);
+	setGpuTiles(map, empty);
+
+	glCreateVertexArrays(1, &map.vaoID);
+	return true;
+}
+
+void setGpuTile(GpuTilemap& map, int x, int y, uint16_t layer)
+{
+	if (x < 0 || y < 0 || x >= map.width || y >= map.height) return;
+
+	glTextureSubImage2D(map.indexTexID, 0, x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_SHORT, &layer);
+}
+
+void setGpuTiles(GpuTilemap& map, const std::vector<uint16_t>& layers)
+{
+	if (layers.size() != (size_t)map.width * map.height)
+	{
+		logError("GpuTilemap:: tile data doesn't match the map size");
+		return;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	glTextureSubImage2D(map.indexTexID, 0, 0, 0, map.width, map.height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, layers.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+static uint32_t gpuTilemapShaderFeatures(BlendMode blendMode)
+{
+	return blendMode == BlendMode::Opaque ? (uint32_t)SHADER_ALPHA_TEST : 0u;
+}
+
+void GpuTilemap::draw(SDL_Window* w, Camera* c)
+{
+	Shader* shader = getShaderVariant(shaderName, gpuTilemapShaderFeatures(blendMode), shaderVariant);
+	if (shader == nullptr)
+	{
+		logError("Shader not found!!");
+		return;
+	}
+
+	glBindTextureUnit(INDEX_TEX_UNIT, indexTexID);
+	glBindSampler(INDEX_TEX_UNIT, 0);
+	glBindTextureUnit(TILE_ARRAY_TEX_UNIT, tileArrayTexID);
+	glBindSampler(TILE_ARRAY_TEX_UNIT, 0);
+
+	shader->registerUniform1i("tileIndexes", INDEX_TEX_UNIT);
+	shader->registerUniform1i("tiles", TILE_ARRAY_TEX_UNIT);
+	shader->registerUniform2f("mapOrigin", origin.x, origin.y);
+	shader->registerUniform2f("tileSize", tileSize.x, tileSize.y);
+	shader->registerUniform1f("additive", additiveFactor(blendMode));
+	if (blendMode == BlendMode::Opaque)
+	{
+		shader->registerUniform1f("alphaCutoff", alphaCutoff(blendMode));
+	}
+	shader->useProgram();
+	applyBlendMode(blendMode);
+
+	glBindVertexArray(vaoID);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void GpuTilemap::cleanup()
+{
+	glDeleteTextures(1, &indexTexID);
+	glDeleteTextures(1, &tileArrayTexID);
+	glDeleteVertexArrays(1, &vaoID);
+}
+
+DrawSortInfo GpuTilemap::getSortInfo() const
+{
+	return DrawSortInfo{ layer, blendMode != BlendMode::Opaque, getShaderVariantID(shaderName, gpuTilemapShaderFeatures(blendMode), shaderVariant), tileArrayTexID, 1.0f };
+}
+
+bool GpuTilemap::getBounds(Bounds2D& bounds) const
+{
+	bounds.minPos = origin;
+	bounds.maxPos = origin + glm::vec2(width * tileSize.x, height * tileSize.y);
+	return true;
+}
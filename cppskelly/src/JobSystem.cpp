@@ -0,0 +1,230 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+struct WorkerQueue
+{
+	std::mutex mutex;
+	std::deque<Job> jobs;
+};
+
+static std::vector<std::unique_ptr<WorkerQueue>> gQueues; // Index 0 belongs to the thread that called init
+static std::vector<std::thread> gWorkers;
+static std::atomic<int> gQueuedJobs(0);
+static std::atomic<bool> gStopWorkers(false);
+static std::mutex gSleepMutex;
+static std::condition_variable gWakeWorkers;
+
+// Threads the job system didn't start share queue 0
+static thread_local int tQueueIndex = 0;
+
+// Ranges per thread in parallelFor, so a thread that finishes early can steal
+static const size_t PARALLEL_FOR_SPLITS_PER_THREAD = 4;
+
+static void pushJob(const Job& job)
+{
+	WorkerQueue& queue = *gQueues[tQueueIndex];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+	++gQueuedJobs;
+	// Taking the sleep mutex orders this against a worker between checking for
+	// work and going to sleep, so the wakeup isn't lost
+	{
+		std::lock_guard<std::mutex> lock(gSleepMutex);
+	}
+	gWakeWorkers.notify_one();
+}
+
+static bool popJob(int index, Job& job)
+{
+	// Own queue newest first, it's the warmest in cache
+	{
+		WorkerQueue& queue = *gQueues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			--gQueuedJobs;
+			return true;
+		}
+	}
+	// Steal the oldest job from someone else, usually the biggest left
+	int numQueues = (int)gQueues.size();
+	for (int i = 1; i < numQueues; ++i)
+	{
+		WorkerQueue& queue = *gQueues[(index + i) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			--gQueuedJobs;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void finishJob(JobCounter* counter)
+{
+	if (counter == nullptr) return;
+
+	// Decremented under the lock so a waiter that sees zero and then takes the
+	// lock knows nobody is still touching the counter
+	std::vector<Job> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (--counter->pending == 0)
+		{
+			released.swap(counter->continuations);
+		}
+	}
+	for (const Job& job : released)
+	{
+		pushJob(job);
+	}
+}
+
+static void executeJob(Job& job)
+{
+	job.func();
+	finishJob(job.counter);
+}
+
+static bool tryRunJob()
+{
+	Job job;
+	if (!popJob(tQueueIndex, job)) return false;
+	executeJob(job);
+	return true;
+}
+
+static void workerLoop(int index)
+{
+	tQueueIndex = index;
+	while (!gStopWorkers)
+	{
+		if (tryRunJob()) continue;
+
+		std::unique_lock<std::mutex> lock(gSleepMutex);
+		gWakeWorkers.wait(lock, [] { return gStopWorkers || gQueuedJobs > 0; });
+	}
+}
+
+bool initJobSystem(int numThreads)
+{
+	if (!gQueues.empty()) shutdownJobSystem();
+
+	if (numThreads <= 0)
+	{
+		numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	for (int i = 0; i < numThreads; ++i)
+	{
+		gQueues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+	}
+	tQueueIndex = 0;
+	gStopWorkers = false;
+	for (int i = 1; i < numThreads; ++i)
+	{
+		gWorkers.push_back(std::thread(workerLoop, i));
+	}
+	return true;
+}
+
+void shutdownJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(gSleepMutex);
+		gStopWorkers = true;
+	}
+	gWakeWorkers.notify_all();
+	for (std::thread& worker : gWorkers)
+	{
+		worker.join();
+	}
+	gWorkers.clear();
+	gQueues.clear();
+	gQueuedJobs = 0;
+}
+
+int getJobThreadCount()
+{
+	return std::max(1, (int)gQueues.size());
+}
+
+void runJob(const TJobFunc& func, JobCounter* counter)
+{
+	Job job = { func, counter };
+	if (counter != nullptr) ++counter->pending;
+	if (gQueues.empty())
+	{
+		executeJob(job);
+		return;
+	}
+	pushJob(job);
+}
+
+void runJobAfter(JobCounter& dependency, const TJobFunc& func, JobCounter* counter)
+{
+	Job job = { func, counter };
+	if (counter != nullptr) ++counter->pending;
+	{
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.pending > 0)
+		{
+			dependency.continuations.push_back(job);
+			return;
+		}
+	}
+	if (gQueues.empty())
+	{
+		executeJob(job);
+		return;
+	}
+	pushJob(job);
+}
+
+void waitForCounter(JobCounter& counter)
+{
+	while (counter.pending > 0)
+	{
+		if (!tryRunJob())
+		{
+			std::this_thread::yield();
+		}
+	}
+	// See finishJob
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body)
+{
+	if (count == 0) return;
+
+	grain = std::max<size_t>(grain, 1);
+	size_t maxSplits = (size_t)getJobThreadCount() * PARALLEL_FOR_SPLITS_PER_THREAD;
+	size_t numSplits = std::min((count + grain - 1) / grain, maxSplits);
+	if (numSplits <= 1 || gQueues.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	size_t step = (count + numSplits - 1) / numSplits;
+	// The caller takes the first range itself instead of queueing it
+	for (size_t begin = step; begin < count; begin += step)
+	{
+		size_t end = std::min(begin + step, count);
+		runJob([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+	body(0, std::min(step, count));
+	waitForCounter(counter);
+}
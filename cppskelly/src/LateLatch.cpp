@@ -0,0 +1,25 @@
+#include "LateLatch.h"
+
+CameraLatch::CameraLatch()
+	:mutex()
+	, camera(), sampleTime()
+	, sequence(0)
+{}
+
+void latchCamera(CameraLatch& latch, const OrthoCamera& camera, TPacingClock::time_point sampleTime)
+{
+	std::lock_guard<std::mutex> lock(latch.mutex);
+	latch.camera = camera;
+	latch.sampleTime = sampleTime;
+	++latch.sequence;
+}
+
+bool readLatchedCamera(CameraLatch& latch, OrthoCamera& camera, TPacingClock::time_point& sampleTime)
+{
+	std::lock_guard<std::mutex> lock(latch.mutex);
+	if (latch.sequence == 0) return false;
+
+	camera = latch.camera;
+	sampleTime = latch.sampleTime;
+	return true;
+}
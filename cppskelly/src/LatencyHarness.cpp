@@ -0,0 +1,143 @@
+#include "LatencyHarness.h"
+#include "FramePacket.h"
+#include "logUtils.h"
+#include "glad/glad.h"
+#include <algorithm>
+#include <sstream>
+
+// However slow the GPU, a probe frame won't hold the render thread longer
+static const GLuint64 PROBE_FENCE_TIMEOUT_NS = 1000000000;
+
+static double millisecondsBetween(TPacingClock::time_point from, TPacingClock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+LatencyHarness::LatencyHarness()
+	:active(false)
+	, eventType((Uint32)-1)
+	, intervalFrames(0), framesUntilProbe(0)
+	, targetProbes(0), probes()
+{}
+
+bool initLatencyHarness(LatencyHarness& harness, size_t numProbes, int intervalFrames)
+{
+	harness.eventType = SDL_RegisterEvents(1);
+	if (harness.eventType == (Uint32)-1)
+	{
+		logError("LatencyHarness:: no user events left to register");
+		return false;
+	}
+	harness.active = true;
+	harness.intervalFrames = std::max(intervalFrames, 1);
+	// Let startup hitches settle before the first one
+	harness.framesUntilProbe = harness.intervalFrames * 4;
+	harness.targetProbes = numProbes;
+	harness.probes.clear();
+	harness.probes.reserve(numProbes);
+	return true;
+}
+
+void injectLatencyProbe(LatencyHarness& harness)
+{
+	if (!harness.active || harness.probes.size() >= harness.targetProbes) return;
+	if (--harness.framesUntilProbe > 0) return;
+
+	harness.framesUntilProbe = harness.intervalFrames;
+	LatencyProbe probe = {};
+	probe.injected = TPacingClock::now();
+	probe.frame = 0;
+	probe.complete = false;
+
+	SDL_Event event = {};
+	event.type = harness.eventType;
+	event.user.code = (Sint32)harness.probes.size();
+	if (SDL_PushEvent(&event) < 1)
+	{
+		logError("LatencyHarness:: couldn't push a probe");
+		return;
+	}
+	harness.probes.push_back(probe);
+}
+
+uint32_t getLatencyProbe(LatencyHarness& harness, const SDL_Event& event)
+{
+	if (!harness.active || event.type != harness.eventType) return NO_LATENCY_PROBE;
+
+	uint32_t probe = (uint32_t)event.user.code;
+	if (probe >= harness.probes.size()) return NO_LATENCY_PROBE;
+	harness.probes[probe].handled = TPacingClock::now();
+	return probe;
+}
+
+void tagLatencyProbe(LatencyHarness& harness, uint32_t probe, uint64_t frame, FramePacket& packet)
+{
+	if (probe >= harness.probes.size()) return;
+
+	harness.probes[probe].frame = frame;
+	packet.latencyProbe = probe;
+}
+
+void finishLatencyProbeFrame(FramePacket& packet)
+{
+	if (packet.latencyProbe == NO_LATENCY_PROBE) return;
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, PROBE_FENCE_TIMEOUT_NS);
+	packet.gpuDoneTime = TPacingClock::now();
+	glDeleteSync(fence);
+}
+
+void collectLatencyProbe(LatencyHarness& harness, const FramePacket& packet)
+{
+	if (packet.latencyProbe >= harness.probes.size()) return;
+
+	LatencyProbe& probe = harness.probes[packet.latencyProbe];
+	probe.submitted = packet.submitTime;
+	probe.presented = packet.presentTime;
+	probe.gpuDone = packet.gpuDoneTime;
+	probe.complete = true;
+}
+
+bool isLatencyHarnessDone(const LatencyHarness& harness)
+{
+	if (!harness.active || harness.probes.size() < harness.targetProbes) return false;
+	for (const LatencyProbe& probe : harness.probes)
+	{
+		if (!probe.complete) return false;
+	}
+	return true;
+}
+
+static void logDistribution(const char* name, std::vector<double>& samples)
+{
+	if (samples.empty()) return;
+
+	std::sort(samples.begin(), samples.end());
+	size_t last = samples.size() - 1;
+	std::ostringstream sstream;
+	sstream << "  " << name << ": " << samples[0] << " / " << samples[last / 2] << " / " << samples[last * 95 / 100]
+		<< " / " << samples[last * 99 / 100] << " / " << samples[last] << " ms";
+	logInfo(sstream.str().c_str());
+}
+
+void logLatencyReport(const LatencyHarness& harness)
+{
+	std::vector<double> toHandled, toSubmit, toPresent, toGpu;
+	for (const LatencyProbe& probe : harness.probes)
+	{
+		if (!probe.complete) continue;
+		toHandled.push_back(millisecondsBetween(probe.injected, probe.handled));
+		toSubmit.push_back(millisecondsBetween(probe.injected, probe.submitted));
+		toPresent.push_back(millisecondsBetween(probe.injected, probe.presented));
+		toGpu.push_back(millisecondsBetween(probe.injected, probe.gpuDone));
+	}
+
+	std::ostringstream sstream;
+	sstream << "Input latency over " << toPresent.size() << " probes, min / median / 95th / 99th / max:";
+	logInfo(sstream.str().c_str());
+	logDistribution("input handled", toHandled);
+	logDistribution("packet submitted", toSubmit);
+	logDistribution("swap returned", toPresent);
+	logDistribution("GPU finished", toGpu);
+}
@@ -1,5 +1,7 @@
 #include "Line.h"
 #include "Camera.h"
+#include "FrameData.h"
+#include "FramePacket.h"
 #include "Shader.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -8,8 +10,11 @@
 
 const int NUM_LINE_VAO = 1;
 const int LINE_VBO_ATTR_POS = 0;
-const int LINE_VBO_ATTR_UV = 2;
-const int LINE_VBO_ATTR_COLOR = 1;
+const int LINE_VBO_ATTR_UV = 1;
+const int LINE_VBO_ATTR_COLOR = 2;
+// Buffers in vboIDs, the attribute locations above are fixed by basic.vert
+static const int LINE_VBO_POS = 0;
+static const int LINE_VBO_COLOUR = 1;
 
 const int LINE_FLOATS_PER_VERTEX = 2;
 const int LINE_FLOATS_PER_UV = 2;
@@ -168,6 +173,7 @@ void setPoints(const std::vector<glm::vec2>& points, LineRenderer& renderer)
 			renderer.vertices.push_back(points[i].y - len * miterNormal.y);
 		}
 	}
+	computeBounds(renderer.vertices.data(), renderer.vertices.size() / 2, renderer.localBounds);
 }
 
 void buildSegment(const glm::vec2& a, const glm::vec2& b, LineRenderer& renderer)
@@ -244,6 +250,8 @@ void buildSegment(const glm::vec2& a, const glm::vec2& b, LineRenderer& renderer
 	renderer.indexes[3] = 1;
 	renderer.indexes[4] = 3;
 	renderer.indexes[5] = 2;
+
+	computeBounds(renderer.vertices.data(), renderer.vertices.size() / 2, renderer.localBounds);
 }
 
 void initGeometry(LineRenderer& renderer)
@@ -254,7 +262,7 @@ void initGeometry(LineRenderer& renderer)
 		glCreateBuffers(NUM_LINE_VBO, renderer.vboIDs);
 
 		// pos
-		glBindBuffer(GL_ARRAY_BUFFER, renderer.vboIDs[LINE_VBO_ATTR_POS]);
+		glBindBuffer(GL_ARRAY_BUFFER, renderer.vboIDs[LINE_VBO_POS]);
 		glBufferData(GL_ARRAY_BUFFER, renderer.vertices.size() * sizeof(GLfloat), renderer.vertices.data(), GL_DYNAMIC_DRAW);
 
 		glVertexAttribPointer(LINE_VBO_ATTR_POS, LINE_FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0)); // Coord. info => Atr. index #0, three floats/vtx
@@ -270,7 +278,7 @@ void initGeometry(LineRenderer& renderer)
 
 
 		// Colours
-		glBindBuffer(GL_ARRAY_BUFFER, renderer.vboIDs[LINE_VBO_ATTR_COLOR]);
+		glBindBuffer(GL_ARRAY_BUFFER, renderer.vboIDs[LINE_VBO_COLOUR]);
 		glBufferData(GL_ARRAY_BUFFER, renderer.colours.size() * sizeof(GLfloat), renderer.colours.data(), GL_DYNAMIC_DRAW);
 
 		glVertexAttribPointer(LINE_VBO_ATTR_COLOR, LINE_FLOATS_PER_COLOUR, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
@@ -297,51 +305,34 @@ void cleanupLine(LineRenderer& line)
 
 void LineRenderer::draw(SDL_Window* w, Camera* c)
 {
-	modelMatrix = glm::translate(glm::vec3(pos.x, pos.y, 0.0f))
-		* glm::rotate(angle, glm::vec3(0.0f, 0.0f, 1.0f))
-		* glm::scale(glm::vec3(scale.x, scale.y, 1.0f));
-
-	glm::mat4 mvp = c->projMatrix * c->viewMatrix * modelMatrix;
 	// Pass matrices, setup shader params, etc
-	TShaderTableIter shaderIt = gShaders.find(shaderName);
-	if (shaderIt == gShaders.end())
+	Shader* shader = getShaderVariant(shaderName, SHADER_VERTEX_COLOUR, shaderVariant);
+	if (shader == nullptr)
 	{
 		logError("Shader not found!!");
 		return;
 	}
 
-	Shader shader = shaderIt->second;
-	shader.bindAttributeLocation(LINE_VBO_ATTR_POS, "inPos");
-	//shader.bindAttributeLocation(LINE_VBO_ATTR_UV, "inTexCoord");
-	shader.bindAttributeLocation(LINE_VBO_ATTR_COLOR, "inColour");
-
-	shader.registerUniformMatrix4f("mvp", (GLfloat*)glm::value_ptr(mvp));
-	shader.useProgram();
+	shader->useProgram();
 
-	if (alphaBlend)
-	{
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	}
-	else
-	{
-		glDisable(GL_BLEND);
-	}
+	shader->registerUniform1f("additive", additiveFactor(blendMode));
+	applyBlendMode(blendMode);
 
 	glBindVertexArray(vaoID);
-	glBindBuffer(GL_ARRAY_BUFFER, vboIDs[LINE_VBO_ATTR_POS]);
+	glBindBuffer(GL_ARRAY_BUFFER, vboIDs[LINE_VBO_POS]);
 	glVertexAttribPointer(LINE_VBO_ATTR_POS, LINE_FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, 0, 0); // Coord. info => Atr. index #0, three floats/vtx
 	glEnableVertexAttribArray(LINE_VBO_ATTR_POS);
 	//glBindBuffer(GL_ARRAY_BUFFER, vboIDs[LINE_VBO_ATTR_UV]);
 	//glVertexAttribPointer(LINE_VBO_ATTR_UV, LINE_FLOATS_PER_UV, GL_FLOAT, GL_FALSE, 0, 0);
 	//glEnableVertexAttribArray(LINE_VBO_ATTR_UV);
-	glBindBuffer(GL_ARRAY_BUFFER, vboIDs[LINE_VBO_ATTR_COLOR]);
+	glBindBuffer(GL_ARRAY_BUFFER, vboIDs[LINE_VBO_COLOUR]);
 	glVertexAttribPointer(LINE_VBO_ATTR_COLOR, LINE_FLOATS_PER_COLOUR, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(LINE_VBO_ATTR_COLOR);
+	enableDrawIDAttribute(gFrameData);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboID);
 
 	//glDrawArrays(GL_TRIANGLES, 0, NUM_SPRITE_TRIANGLES_VERT_COUNT);
-	glDrawElements(GL_TRIANGLES, (GLsizei)indexes.size(), GL_UNSIGNED_INT, nullptr);
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, (GLsizei)indexes.size(), GL_UNSIGNED_INT, nullptr, 1, drawIndex);
 	//glDrawArrays(GL_TRIANGLES, 0, NUM_SPRITE_TRIANGLES_VERT_COUNT);
 }
 
@@ -349,7 +340,7 @@ void updateGeometry(LineRenderer& renderer)
 {
 	glBindVertexArray(renderer.vaoID); // current vtex array
 									  // pos
-	glBindBuffer(GL_ARRAY_BUFFER, renderer.vboIDs[LINE_VBO_ATTR_POS]);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.vboIDs[LINE_VBO_POS]);
 	glBufferSubData(GL_ARRAY_BUFFER, 0, renderer.vertices.size() * sizeof(GLfloat), renderer.vertices.data());
 	glVertexAttribPointer(LINE_VBO_ATTR_POS, LINE_FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, 0, 0); // Coord. info => Atr. index #0, three floats/vtx
 
@@ -357,7 +348,7 @@ void updateGeometry(LineRenderer& renderer)
 	//glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(renderer.uvs), &renderer.uvs);
 	//glVertexAttribPointer(LINE_VBO_ATTR_UV, LINE_FLOATS_PER_UV, GL_FLOAT, GL_FALSE, 0, 0); // Coord. info => Atr. index #0, 2 floats/UV
 
-	glBindBuffer(GL_ARRAY_BUFFER, renderer.vboIDs[LINE_VBO_ATTR_COLOR]);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.vboIDs[LINE_VBO_COLOUR]);
 	glBufferSubData(GL_ARRAY_BUFFER, 0, renderer.colours.size() * sizeof(GLfloat), renderer.colours.data());
 	glVertexAttribPointer(LINE_VBO_ATTR_COLOR, LINE_FLOATS_PER_COLOUR, GL_FLOAT, GL_FALSE, 0, 0); // Coord. info => Atr. index #0, 4 floats/Col
 }
@@ -372,6 +363,40 @@ void LineRenderer::cleanup()
 
 }
 
+bool LineRenderer::getDrawData(DrawData& data) const
+{
+	data.model = buildModelMatrix(pos, angle, scale);
+	return true;
+}
+
+bool LineRenderer::recordDraw(FramePacket& packet, PacketDraw& draw)
+{
+	if (vertices.empty()) return false;
+
+	draw.dataSize = (uint32_t)(vertices.size() * sizeof(GLfloat));
+	draw.dataOffset = appendPacketData(packet, vertices.data(), draw.dataSize);
+	return true;
+}
+
+void LineRenderer::drawRecorded(SDL_Window* w, Camera* c, const FramePacket& packet, const PacketDraw& draw)
+{
+	glNamedBufferSubData(vboIDs[LINE_VBO_POS], 0, draw.dataSize, getPacketData(packet, draw));
+	this->draw(w, c);
+}
+
+bool LineRenderer::getBounds(Bounds2D& bounds) const
+{
+	if (vertices.empty()) return false;
+
+	bounds = transformBounds(localBounds, pos, scale, angle);
+	return true;
+}
+
+DrawSortInfo LineRenderer::getSortInfo() const
+{
+	return DrawSortInfo{ layer, blendMode != BlendMode::Opaque, getShaderVariantID(shaderName, SHADER_VERTEX_COLOUR, shaderVariant), texID, 0.0f };
+}
+
 void setRendererColours(int numPoints, LineRenderer& renderer)
 {
 	int numVertices = 2 * numPoints;
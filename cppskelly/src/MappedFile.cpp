@@ -0,0 +1,162 @@
+#include "MappedFile.h"
+#include "logUtils.h"
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	:data(nullptr)
+	, size(0)
+#ifdef _WIN32
+	, fileHandle(nullptr)
+	, mappingHandle(nullptr)
+#else
+	, fd(-1)
+#endif
+{}
+
+static void logMapError(const std::string& path, const char* what)
+{
+	std::ostringstream sstream;
+	sstream << "MappedFile:: " << what << " " << path.c_str();
+	logError(sstream.str().c_str());
+}
+
+#ifdef _WIN32
+
+bool openMappedFile(const std::string& path, MappedFile& file)
+{
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		logMapError(path, "could not open");
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		logMapError(path, "empty or unreadable");
+		CloseHandle(handle);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		logMapError(path, "could not create a mapping for");
+		CloseHandle(handle);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		logMapError(path, "could not map");
+		CloseHandle(mapping);
+		CloseHandle(handle);
+		return false;
+	}
+
+	file.fileHandle = handle;
+	file.mappingHandle = mapping;
+	file.data = (const uint8_t*)view;
+	file.size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void closeMappedFile(MappedFile& file)
+{
+	if (file.data != nullptr)
+	{
+		UnmapViewOfFile(file.data);
+		CloseHandle((HANDLE)file.mappingHandle);
+		CloseHandle((HANDLE)file.fileHandle);
+	}
+	file = MappedFile();
+}
+
+void adviseMappedRange(const MappedFile& file, size_t offset, size_t size, bool willNeed)
+{
+	if (file.data == nullptr || offset >= file.size) return;
+	if (offset + size > file.size) size = file.size - offset;
+
+	// Unlocking pages that were never locked drops them from the working set
+	if (willNeed)
+	{
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = (PVOID)(file.data + offset);
+		range.NumberOfBytes = size;
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+	else
+	{
+		VirtualUnlock((LPVOID)(file.data + offset), size);
+	}
+}
+
+#else
+
+bool openMappedFile(const std::string& path, MappedFile& file)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		logMapError(path, "could not open");
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		logMapError(path, "empty or unreadable");
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		logMapError(path, "could not map");
+		close(fd);
+		return false;
+	}
+
+	file.fd = fd;
+	file.data = (const uint8_t*)view;
+	file.size = (size_t)info.st_size;
+	return true;
+}
+
+void closeMappedFile(MappedFile& file)
+{
+	if (file.data != nullptr)
+	{
+		munmap((void*)file.data, file.size);
+		close(file.fd);
+	}
+	file = MappedFile();
+}
+
+void adviseMappedRange(const MappedFile& file, size_t offset, size_t size, bool willNeed)
+{
+	if (file.data == nullptr || offset >= file.size) return;
+	if (offset + size > file.size) size = file.size - offset;
+
+	// madvise wants page aligned addresses
+	const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t alignedOffset = offset & ~(pageSize - 1);
+	size += offset - alignedOffset;
+	madvise((void*)(file.data + alignedOffset), size, willNeed ? MADV_WILLNEED : MADV_DONTNEED);
+}
+
+#endif
@@ -0,0 +1,257 @@
+#include "RenderQueue.h"
+#include "Camera.h"
+#include "FrameData.h"
+#include "FramePacket.h"
+#include "glad/glad.h"
+#include <algorithm>
+#include <cstring>
+
+static const int KEY_LAYER_SHIFT = 56;
+static const int KEY_TRANSLUCENT_SHIFT = 55;
+static const uint64_t KEY_SHADER_MASK = 0xfff;
+static const uint64_t KEY_TEXTURE_MASK = 0xffff;
+static const uint64_t KEY_DEPTH_MASK = 0xffffff;
+
+static uint64_t quantiseDepth(float depth)
+{
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+	return (uint64_t)(depth * (float)KEY_DEPTH_MASK) & KEY_DEPTH_MASK;
+}
+
+uint64_t makeSortKey(const DrawSortInfo& info)
+{
+	uint64_t key = (uint64_t)info.layer << KEY_LAYER_SHIFT;
+	uint64_t shader = info.shaderID & KEY_SHADER_MASK;
+	uint64_t texture = info.textureID & KEY_TEXTURE_MASK;
+	uint64_t depth = quantiseDepth(info.depth);
+	if (info.translucent)
+	{
+		key |= 1ull << KEY_TRANSLUCENT_SHIFT;
+		key |= (KEY_DEPTH_MASK - depth) << 31;
+		key |= shader << 19;
+		key |= texture << 3;
+	}
+	else
+	{
+		key |= shader << 43;
+		key |= texture << 27;
+		key |= depth << 3;
+	}
+	return key;
+}
+
+RenderQueue::RenderQueue()
+	:drawables(), recorded(), packet(nullptr)
+	, infos(), entries(), scratch()
+	, stats()
+	, depthPrepass(false)
+	, cull(true), hasCullBounds(false), cullBounds()
+{}
+
+void clearRenderQueue(RenderQueue& queue, const Camera* c)
+{
+	queue.drawables.clear();
+	queue.recorded.clear();
+	queue.packet = nullptr;
+	queue.infos.clear();
+	queue.entries.clear();
+	queue.stats.culled = 0;
+	queue.hasCullBounds = c != nullptr && getCullBounds(c, queue.cullBounds);
+}
+
+void submitDrawable(RenderQueue& queue, Drawable* drawable)
+{
+	Bounds2D bounds;
+	if (queue.cull && queue.hasCullBounds && drawable->getBounds(bounds) && !isVisible(queue.cullBounds, bounds))
+	{
+		++queue.stats.culled;
+		return;
+	}
+
+	RenderQueueEntry entry;
+	entry.index = (uint32_t)queue.drawables.size();
+	queue.drawables.push_back(drawable);
+	queue.recorded.push_back(nullptr);
+	queue.infos.push_back(drawable->getSortInfo());
+	entry.key = makeSortKey(queue.infos.back());
+	queue.entries.push_back(entry);
+}
+
+void submitPacketDraws(RenderQueue& queue, const FramePacket& packet)
+{
+	queue.packet = &packet;
+	queue.stats.culled += packet.culled;
+	for (const PacketDraw& draw : packet.draws)
+	{
+		RenderQueueEntry entry;
+		entry.index = (uint32_t)queue.drawables.size();
+		queue.drawables.push_back(draw.drawable);
+		queue.recorded.push_back(&draw);
+		queue.infos.push_back(draw.drawable->getSortInfo());
+		entry.key = makeSortKey(queue.infos.back());
+		queue.entries.push_back(entry);
+	}
+}
+
+int radixSortEntries(std::vector<RenderQueueEntry>& entries, std::vector<RenderQueueEntry>& scratch)
+{
+	const size_t count = entries.size();
+	if (count < 2) return 0;
+	scratch.resize(count);
+
+	// All eight histograms in one read of the keys
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (const RenderQueueEntry& entry : entries)
+	{
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			++histograms[pass][(entry.key >> (pass * 8)) & 0xff];
+		}
+	}
+
+	RenderQueueEntry* src = entries.data();
+	RenderQueueEntry* dst = scratch.data();
+	int passes = 0;
+	for (int pass = 0; pass < 8; ++pass)
+	{
+		uint32_t* histogram = histograms[pass];
+		const int shift = pass * 8;
+		// Every key has the same byte here, the pass wouldn't move anything
+		if (histogram[(src[0].key >> shift) & 0xff] == count) continue;
+
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; ++bucket)
+		{
+			uint32_t n = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+		}
+		std::swap(src, dst);
+		++passes;
+	}
+
+	if (src != entries.data())
+	{
+		entries.swap(scratch);
+	}
+	return passes;
+}
+
+static int countStateChanges(const std::vector<RenderQueueEntry>& entries, const std::vector<DrawSortInfo>& infos)
+{
+	int changes = 0;
+	const DrawSortInfo* last = nullptr;
+	for (const RenderQueueEntry& entry : entries)
+	{
+		const DrawSortInfo& info = infos[entry.index];
+		if (last == nullptr)
+		{
+			changes += 3;
+		}
+		else
+		{
+			changes += last->shaderID != info.shaderID;
+			changes += last->textureID != info.textureID;
+			changes += last->translucent != info.translucent;
+		}
+		last = &info;
+	}
+	return changes;
+}
+
+void sortRenderQueue(RenderQueue& queue)
+{
+	queue.stats.commands = (int)queue.entries.size();
+	queue.stats.stateChangesUnsorted = countStateChanges(queue.entries, queue.infos);
+	queue.stats.radixPasses = radixSortEntries(queue.entries, queue.scratch);
+	queue.stats.stateChangesSorted = countStateChanges(queue.entries, queue.infos);
+}
+
+float layerDepth(uint8_t layer)
+{
+	return 1.0f - (layer + 1) / 257.0f;
+}
+
+static void drawEntry(RenderQueue& queue, const RenderQueueEntry& entry, SDL_Window* w, Camera* c)
+{
+	const PacketDraw* recorded = queue.recorded[entry.index];
+	if (recorded != nullptr)
+	{
+		queue.drawables[entry.index]->drawRecorded(w, c, *queue.packet, *recorded);
+	}
+	else
+	{
+		queue.drawables[entry.index]->draw(w, c);
+	}
+}
+
+static void drawAtLayerDepth(RenderQueue& queue, const RenderQueueEntry& entry, SDL_Window* w, Camera* c)
+{
+	float depth = layerDepth(queue.infos[entry.index].layer);
+	glDepthRangef(depth, depth);
+	drawEntry(queue, entry, w, c);
+}
+
+// One entry per drawable that wants one, in draw order, then a single upload
+static void gatherDrawData(RenderQueue& queue)
+{
+	clearDrawData(gFrameData);
+	DrawData data;
+	for (const RenderQueueEntry& entry : queue.entries)
+	{
+		Drawable* drawable = queue.drawables[entry.index];
+		const PacketDraw* recorded = queue.recorded[entry.index];
+		if (recorded != nullptr)
+		{
+			drawable->drawIndex = recorded->hasDrawData ? addDrawData(gFrameData, recorded->drawData) : 0;
+		}
+		else
+		{
+			drawable->drawIndex = drawable->getDrawData(data) ? addDrawData(gFrameData, data) : 0;
+		}
+	}
+	uploadDrawData(gFrameData);
+}
+
+void flushRenderQueue(RenderQueue& queue, SDL_Window* w, Camera* c)
+{
+	gatherDrawData(queue);
+
+	if (!queue.depthPrepass)
+	{
+		for (const RenderQueueEntry& entry : queue.entries)
+		{
+			drawEntry(queue, entry, w, c);
+		}
+		return;
+	}
+
+	// Opaque, nearest first. Walking the whole list backwards keeps draws
+	// grouped by state, and of two equal keys the later one wins like it
+	// would have by overdrawing.
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	for (size_t i = queue.entries.size(); i-- > 0;)
+	{
+		if (queue.infos[queue.entries[i].index].translucent) continue;
+		drawAtLayerDepth(queue, queue.entries[i], w, c);
+	}
+
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+	for (const RenderQueueEntry& entry : queue.entries)
+	{
+		if (!queue.infos[entry.index].translucent) continue;
+		drawAtLayerDepth(queue, entry, w, c);
+	}
+
+	glDepthMask(GL_TRUE);
+	glDepthRangef(0.0f, 1.0f);
+	glDisable(GL_DEPTH_TEST);
+}
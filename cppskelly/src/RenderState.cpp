@@ -0,0 +1,31 @@
+#include "RenderState.h"
+#include "glad/glad.h"
+
+static bool gBlendStateKnown = false;
+static bool gBlendEnabled = false;
+
+void applyBlendMode(BlendMode mode)
+{
+	bool enable = mode != BlendMode::Opaque;
+	if (gBlendStateKnown && gBlendEnabled == enable)
+	{
+		return;
+	}
+
+	if (enable)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	}
+	else
+	{
+		glDisable(GL_BLEND);
+	}
+	gBlendEnabled = enable;
+	gBlendStateKnown = true;
+}
+
+void invalidateRenderState()
+{
+	gBlendStateKnown = false;
+}
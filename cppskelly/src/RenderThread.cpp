@@ -0,0 +1,126 @@
+#include "RenderThread.h"
+#include "logUtils.h"
+#include <chrono>
+
+// Spins before a waiting thread starts sleeping, a frame's handoff usually
+// lands within them
+static const int BACKOFF_SPINS = 64;
+static const int BACKOFF_SLEEP_MICROSECONDS = 100;
+
+static void backoff(int& spins)
+{
+	if (++spins < BACKOFF_SPINS)
+	{
+		std::this_thread::yield();
+	}
+	else
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(BACKOFF_SLEEP_MICROSECONDS));
+	}
+}
+
+static void renderPacket(RenderThread& renderer, FramePacket* packet)
+{
+	renderer.renderPacket(renderer.window, *packet);
+	packet->rendered = true;
+	int spins = 0;
+	while (!pushSpsc(renderer.done, packet))
+	{
+		backoff(spins);
+	}
+}
+
+static void renderLoop(RenderThread* renderer)
+{
+	if (SDL_GL_MakeCurrent(renderer->window, renderer->context) != 0)
+	{
+		logError("Render thread couldn't take the GL context");
+	}
+
+	int spins = 0;
+	FramePacket* packet = nullptr;
+	for (;;)
+	{
+		if (popSpsc(renderer->ready, packet))
+		{
+			renderPacket(*renderer, packet);
+			spins = 0;
+		}
+		else if (renderer->stop)
+		{
+			// Stop is raised after the last push, so the queue really is empty
+			if (!popSpsc(renderer->ready, packet)) break;
+			renderPacket(*renderer, packet);
+		}
+		else
+		{
+			backoff(spins);
+		}
+	}
+	SDL_GL_MakeCurrent(renderer->window, nullptr);
+}
+
+RenderThread::RenderThread()
+	:window(nullptr), context(nullptr)
+	, renderPacket(nullptr)
+	, packets(), ready(), done()
+	, thread(), stop(false)
+	, threaded(false)
+{}
+
+bool startRenderThread(RenderThread& renderer, SDL_Window* w, SDL_GLContext context, TRenderPacketFunc renderPacket, bool threaded)
+{
+	renderer.window = w;
+	renderer.context = context;
+	renderer.renderPacket = renderPacket;
+	renderer.threaded = threaded;
+	renderer.stop = false;
+	for (size_t i = 0; i < FRAME_PACKET_COUNT; ++i)
+	{
+		pushSpsc(renderer.done, &renderer.packets[i]);
+	}
+	if (!threaded) return true;
+
+	if (SDL_GL_MakeCurrent(w, nullptr) != 0)
+	{
+		logError("Couldn't release the GL context, rendering on the main thread");
+		renderer.threaded = false;
+		return false;
+	}
+	renderer.thread = std::thread(renderLoop, &renderer);
+	return true;
+}
+
+void stopRenderThread(RenderThread& renderer)
+{
+	if (!renderer.threaded) return;
+
+	renderer.stop = true;
+	renderer.thread.join();
+	SDL_GL_MakeCurrent(renderer.window, renderer.context);
+	renderer.threaded = false;
+}
+
+FramePacket* acquireFramePacket(RenderThread& renderer)
+{
+	FramePacket* packet = nullptr;
+	int spins = 0;
+	while (!popSpsc(renderer.done, packet))
+	{
+		backoff(spins);
+	}
+	return packet;
+}
+
+void submitFramePacket(RenderThread& renderer, FramePacket* packet)
+{
+	packet->submitTime = TPacingClock::now();
+	if (!renderer.threaded)
+	{
+		renderPacket(renderer, packet);
+		return;
+	}
+
+	// Can't be full: only FRAME_PACKET_COUNT packets exist
+	pushSpsc(renderer.ready, packet);
+}
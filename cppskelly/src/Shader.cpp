@@ -1,12 +1,85 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <thread>
 #include "Shader.h"
+#include "GLUtils.h"
 #include "logUtils.h"
 
 TShaderTable gShaders;
+ShaderCacheStats gShaderCacheStats = { 0, 0 };
+
+static std::string gShaderCacheDir;
+static bool gParallelShaderCompile = false;
+
+static const char PROGRAM_BINARY_MAGIC[4] = { 'S', 'K', 'P', 'B' };
+static const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+// Cache file layout: this header, then length bytes of binary
+struct ProgramBinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+void setShaderCacheDir(const std::string& dir)
+{
+	gShaderCacheDir = dir;
+}
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	// FNV-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const char* string)
+{
+	// Keep the terminator so "ab"+"c" and "a"+"bc" differ
+	return string != nullptr ? hashBytes(hash, string, strlen(string) + 1) : hashBytes(hash, "", 1);
+}
+
+// Binaries are only valid for the driver that produced them, so it's part of the key
+static uint64_t hashProgram(const std::vector<std::string>& sources, const GLenum* types)
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		hash = hashBytes(hash, &types[i], sizeof(GLenum));
+		hash = hashString(hash, sources[i].c_str());
+	}
+	return hash;
+}
+
+static std::string programBinaryPath(uint64_t key)
+{
+	std::ostringstream path;
+	path << gShaderCacheDir << "program_" << std::hex << key << ".bin";
+	return path.str();
+}
+
+GLuint findProgramID(const std::string& name)
+{
+	TShaderTableIter it = gShaders.find(name);
+	return it == gShaders.end() ? 0 : it->second.GetShaderID();
+}
 
 Shader::Shader()
+	:mProgram(0), mFrag(0), mVert(0), mShaderIds()
+	, mCacheKey(0), mUseCache(false), mPending(false)
 {}
 
 Shader::~Shader()
@@ -14,12 +87,17 @@ Shader::~Shader()
 
 std::string Shader::getFileContents(const std::string& file)
 {
-	std::ifstream t(file);
-	std::stringstream buffer;
-	buffer << t.rdbuf();
-
-	// Make a std::string and fill it with the contents of buffer
-	std::string fileContent = buffer.str();
+	// Straight into a string of the right size, no stream copies
+	std::ifstream t(file, std::ios::binary | std::ios::ate);
+	std::string fileContent;
+	if (!t)
+	{
+		logError(("Couldn't open " + file).c_str());
+		return fileContent;
+	}
+	fileContent.resize((size_t)t.tellg());
+	t.seekg(0);
+	t.read(&fileContent[0], (std::streamsize)fileContent.size());
 	return fileContent;
 }
 
@@ -33,29 +111,100 @@ void Shader::useProgram()
 	glUseProgram(mProgram);
 }
 
-bool Shader::init(const char** filenames, GLenum* types, int numShaders)
+bool Shader::loadProgramBinary(uint64_t key)
+{
+	std::ifstream file(programBinaryPath(key), std::ios::binary);
+	if (!file) return false;
+
+	ProgramBinaryHeader header;
+	if (!file.read((char*)&header, sizeof(header))
+		|| memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != PROGRAM_BINARY_VERSION || header.key != key)
+	{
+		return false;
+	}
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), header.length)) return false;
+
+	// Drivers reject binaries from other versions here, then it's a normal compile
+	mProgram = glCreateProgram();
+	glProgramBinary(mProgram, header.format, binary.data(), (GLsizei)header.length);
+	GLint result = 0;
+	glGetProgramiv(mProgram, GL_LINK_STATUS, &result);
+	if (result == 0)
+	{
+		glDeleteProgram(mProgram);
+		mProgram = 0;
+		return false;
+	}
+	return true;
+}
+
+void Shader::saveProgramBinary(uint64_t key)
+{
+	GLint length = 0;
+	glGetProgramiv(mProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(mProgram, length, &length, &format, binary.data());
+
+	ProgramBinaryHeader header;
+	memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+	header.version = PROGRAM_BINARY_VERSION;
+	header.key = key;
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	std::ofstream file(programBinaryPath(key), std::ios::binary | std::ios::trunc);
+	if (!file.write((const char*)&header, sizeof(header)) || !file.write(binary.data(), length))
+	{
+		logError("Couldn't write the program binary cache");
+	}
+}
+
+bool Shader::init(const char** filenames, GLenum* types, int numShaders, uint32_t features)
+{
+	return begin(filenames, types, numShaders, features) && finish();
+}
+
+bool Shader::begin(const char** filenames, GLenum* types, int numShaders, uint32_t features)
 { 
 	mShaderIds.clear();
-	int result = 0;
+	mPending = false;
+
+	std::vector<std::string> sources(numShaders);
+	for (int i = 0; i < numShaders; ++i)
+	{
+		if (!preprocessShader(filenames[i], features, sources[i]))
+		{
+			return false;
+		}
+	}
 
-	// Create and compile shaders
+	GLint numBinaryFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+	mUseCache = !gShaderCacheDir.empty() && numBinaryFormats > 0;
+	mCacheKey = mUseCache ? hashProgram(sources, types) : 0;
+	if (mUseCache && loadProgramBinary(mCacheKey))
+	{
+		++gShaderCacheStats.loaded;
+		return true;
+	}
+	++gShaderCacheStats.compiled;
+
+	// Create and compile shaders. Nothing asks for a status until finish, so
+	// the driver is free to keep compiling in the background.
 	for (int i = 0; i < numShaders; ++i)
 	{
 		GLuint shaderID = glCreateShader(types[i]);
-		std::string fileContents = getFileContents(filenames[i]);
+		const std::string& fileContents = sources[i];
 		const char* contents = fileContents.c_str();
 		GLint size = (GLint)fileContents.length();
 		glShaderSource(shaderID, 1, &contents, &size);
 		glCompileShader(shaderID);
 
-		glGetShaderiv(shaderID, GL_COMPILE_STATUS, &result);
-
-		if (result == 0)
-		{
-			traceShaderCompileError(shaderID);
-			return false;
-		}
-
 		if (types[i] == GL_VERTEX_SHADER)
 		{
 			mVert = shaderID;
@@ -72,9 +221,42 @@ bool Shader::init(const char** filenames, GLenum* types, int numShaders)
 	{
 		glAttachShader(mProgram, shaderID);
 	}
+	if (mUseCache)
+	{
+		glProgramParameteri(mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	
 	// Link shaders
 	glLinkProgram(mProgram);
+	mPending = true;
+	return true;
+}
+
+bool Shader::isReady() const
+{
+	if (!mPending || !gParallelShaderCompile) return true;
+
+	GLint done = 0;
+	glGetProgramiv(mProgram, GL_COMPLETION_STATUS_KHR, &done);
+	return done != 0;
+}
+
+bool Shader::finish()
+{
+	if (!mPending) return true;
+	mPending = false;
+
+	int result = 0;
+	for (GLuint shaderID : mShaderIds)
+	{
+		glGetShaderiv(shaderID, GL_COMPILE_STATUS, &result);
+		if (result == 0)
+		{
+			traceShaderCompileError(shaderID);
+			return false;
+		}
+	}
+
 	glGetProgramiv(mProgram, GL_LINK_STATUS, (int *)&result);
 	if (result == 0)
 	{
@@ -87,9 +269,213 @@ bool Shader::init(const char** filenames, GLenum* types, int numShaders)
 		glDeleteShader(shaderID);
 	}
 
+	if (mUseCache)
+	{
+		saveProgramBinary(mCacheKey);
+	}
 	return true; 
 }
 
+bool initParallelShaderCompile(GLADloadproc loader)
+{
+	gParallelShaderCompile = hasGLExtension("GL_KHR_parallel_shader_compile");
+	if (!gParallelShaderCompile) return false;
+
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsKHR");
+	if (maxShaderCompilerThreads != nullptr)
+	{
+		maxShaderCompilerThreads(0xffffffff); // As many as the driver likes
+	}
+	return true;
+}
+
+static const char* SHADER_FEATURE_DEFINES[NUM_SHADER_FEATURES] = { "TEXTURED", "VERTEX_COLOUR", "ALPHA_TEST", "PALETTED" };
+static const int MAX_INCLUDE_DEPTH = 8;
+
+static std::map<std::string, ShaderProgramDesc> gShaderPrograms;
+
+static bool expandIncludes(const std::string& path, int depth, std::string& out)
+{
+	if (depth > MAX_INCLUDE_DEPTH)
+	{
+		logError(("Shader includes nested too deep (cycle?) at " + path).c_str());
+		return false;
+	}
+	std::ifstream file(path);
+	if (!file)
+	{
+		logError(("Couldn't open " + path).c_str());
+		return false;
+	}
+	std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		++lineNumber;
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+		{
+			out += line;
+			out += '\n';
+			continue;
+		}
+
+		size_t open = line.find('"', start);
+		size_t close = open != std::string::npos ? line.find('"', open + 1) : std::string::npos;
+		if (close == std::string::npos)
+		{
+			logError(("Bad #include in " + path + ": " + line).c_str());
+			return false;
+		}
+		if (!expandIncludes(directory + line.substr(open + 1, close - open - 1), depth + 1, out))
+		{
+			return false;
+		}
+		// Keep compiler messages pointing at the right line of this file
+		out += "#line " + std::to_string(lineNumber + 1) + "\n";
+	}
+	return true;
+}
+
+bool preprocessShader(const std::string& path, uint32_t features, std::string& source)
+{
+	source.clear();
+	if (!expandIncludes(path, 0, source)) return false;
+
+	// Defines go right after #version, which has to stay first
+	size_t insertAt = 0;
+	if (source.compare(0, 8, "#version") == 0)
+	{
+		insertAt = source.find('\n');
+		insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+	}
+	std::string defines;
+	for (int i = 0; i < NUM_SHADER_FEATURES; ++i)
+	{
+		if (features & (1u << i))
+		{
+			defines += std::string("#define ") + SHADER_FEATURE_DEFINES[i] + "\n";
+		}
+	}
+	if (!defines.empty())
+	{
+		defines += "#line 2\n";
+		source.insert(insertAt, defines);
+	}
+	return true;
+}
+
+void registerShaderProgram(const std::string& program, const ShaderProgramDesc& desc)
+{
+	gShaderPrograms[program] = desc;
+}
+
+std::string shaderVariantName(const std::string& program, uint32_t features)
+{
+	std::ostringstream name;
+	name << program << '#' << std::hex << features;
+	return name.str();
+}
+
+bool createShaders(const std::vector<ShaderRequest>& requests, bool parallel)
+{
+	bool ok = true;
+	std::vector<std::pair<std::string, Shader>> pending;
+	for (const ShaderRequest& request : requests)
+	{
+		std::map<std::string, ShaderProgramDesc>::const_iterator it = gShaderPrograms.find(request.program);
+		if (it == gShaderPrograms.end())
+		{
+			logError(("Unknown shader program: " + request.program).c_str());
+			ok = false;
+			continue;
+		}
+		const ShaderProgramDesc& desc = it->second;
+		uint32_t features = request.features & desc.features;
+		std::string name = shaderVariantName(request.program, features);
+		if (gShaders.count(name) > 0) continue;
+
+		std::vector<const char*> files;
+		for (const std::string& file : desc.files)
+		{
+			files.push_back(file.c_str());
+		}
+		std::vector<GLenum> types(desc.types);
+
+		Shader s;
+		if (!s.begin(files.data(), types.data(), (int)files.size(), features) || (!parallel && !s.finish()))
+		{
+			logError(("Shader init failed: " + name).c_str());
+			ok = false;
+			continue;
+		}
+		pending.push_back(std::make_pair(name, s));
+	}
+
+	// Everything is in flight, collect programs as they complete
+	while (!pending.empty())
+	{
+		bool collected = false;
+		for (size_t i = 0; i < pending.size();)
+		{
+			Shader& s = pending[i].second;
+			if (!s.isReady())
+			{
+				++i;
+				continue;
+			}
+			if (s.finish())
+			{
+				gShaders[pending[i].first] = s;
+			}
+			else
+			{
+				logError(("Shader init failed: " + pending[i].first).c_str());
+				ok = false;
+			}
+			pending.erase(pending.begin() + i);
+			collected = true;
+		}
+		if (!collected)
+		{
+			std::this_thread::yield();
+		}
+	}
+	return ok;
+}
+
+Shader* getShaderVariant(const std::string& program, uint32_t features, ShaderVariantCache& cache)
+{
+	// Failures stay cached too, so a broken variant isn't rebuilt every frame
+	if (!program.empty() && cache.program == program && cache.features == features)
+	{
+		return cache.shader;
+	}
+	cache.program = program;
+	cache.features = features;
+	cache.shader = nullptr;
+
+	std::map<std::string, ShaderProgramDesc>::const_iterator it = gShaderPrograms.find(program);
+	if (it == gShaderPrograms.end())
+	{
+		logError(("Unknown shader program: " + program).c_str());
+		return nullptr;
+	}
+	std::string name = shaderVariantName(program, features & it->second.features);
+	TShaderTableIter shaderIt = gShaders.find(name);
+	if (shaderIt == gShaders.end())
+	{
+		// Fine for the odd variant, a hitch if it happens mid-game: add it to the startup list
+		logInfo(("Compiling shader variant " + name + " on first use").c_str());
+		createShaders({ { program, features } }, false);
+		shaderIt = gShaders.find(name);
+	}
+	cache.shader = shaderIt != gShaders.end() ? &shaderIt->second : nullptr;
+	return cache.shader;
+}
+
 void Shader::cleanUp()
 {
 	/* Cleanup all the things we bound and allocated */
@@ -161,6 +547,12 @@ void Shader::registerUniform1f(const std::string& name, GLfloat value)
 	glProgramUniform1f(mProgram, loc, value);
 }
 
+void Shader::registerUniform2f(const std::string& name, GLfloat x, GLfloat y)
+{
+	GLint loc = glGetUniformLocation(mProgram, name.c_str());
+	glProgramUniform2f(mProgram, loc, x, y);
+}
+
 void Shader::registerUniformMatrix4f(const std::string& name, GLfloat* matrix)
 {
 	GLint loc = glGetUniformLocation(mProgram, name.c_str());
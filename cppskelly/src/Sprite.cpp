@@ -1,8 +1,12 @@
 #include "Sprite.h"
 #include "Camera.h"
+#include "FrameData.h"
 #include "Shader.h"
 #include "Texture.h"
 #include "logUtils.h"
+#include <SDL_surface.h>
+#include <algorithm>
+#include <sstream>
 
 const int NUM_SPRITE_VAO = 1;
 const int SPRITE_VBO_ATTR_POS = 0;
@@ -18,55 +22,62 @@ const char* DEFAULT_SHADER_NAME = "sprites_default";
 Sprite::Sprite(const std::string& name)
 	:name(name)
 	, texPath(), shaderName()
-	, texID(0), shaderID(0), samplerID(0)
+	, texID(0), paletteTexID(0), samplerID(0), shaderVariant()
+	, numIndexes(0), hull(), localBounds()
 	, clipRect()
 	, width(0.0f), height(0.0f), angle(0.0f)
 	, pos(), scale(1.0f, 1.0f)
-	, pivot(), modelMatrix(), alphaBlend(false)
-{}
+	, pivot(), blendMode(BlendMode::Opaque)
+{
+	setUnitQuadHull(hull);
+}
 
 Sprite::~Sprite()
 {
 
 }
 
+// Smallest variant that draws this sprite
+static uint32_t spriteShaderFeatures(const Sprite& sprite)
+{
+	uint32_t features = SHADER_TEXTURED;
+	if (sprite.paletteTexID != 0) features |= SHADER_PALETTED;
+	if (sprite.blendMode == BlendMode::Opaque) features |= SHADER_ALPHA_TEST;
+	return features;
+}
+
 void Sprite::draw(SDL_Window* w, Camera* cam)
 {
-	modelMatrix = glm::translate(glm::vec3(pos.x, pos.y, 0.0f))
-		* glm::rotate(angle, glm::vec3(0.0f, 0.0f, 1.0f))
+	if (numIndexes == 0) return; // Nothing visible
 
-		* glm::scale(glm::vec3(scale.x, scale.y, 1.0f));
-	glm::mat4 mvp = cam->projMatrix * cam->viewMatrix * modelMatrix;
 	// Pass matrices, setup shader params, etc
-	TShaderTableIter shaderIt = gShaders.find(shaderName);
-	if (shaderIt == gShaders.end())
+	Shader* shader = getShaderVariant(shaderName, spriteShaderFeatures(*this), shaderVariant);
+	if (shader == nullptr)
 	{
 		logError("Shader not found!!");
 		return;
 	}
 
-	Shader shader = shaderIt->second;
-	shader.bindAttributeLocation(SPRITE_VBO_ATTR_POS, "inPos");
-	shader.bindAttributeLocation(SPRITE_VBO_ATTR_UV, "inTexCoord");
-
 	const int TEX_UNIT = 0;
 	glActiveTexture(GL_TEXTURE0 + TEX_UNIT); // The 0 addition seems to be a convention to specify the texture unit
 	glBindTexture(GL_TEXTURE_2D, texID);
 	glBindSampler(TEX_UNIT, samplerID);
 
-	shader.registerUniform1i("texture", 0);
-	shader.registerUniformMatrix4f("mvp", (GLfloat*)glm::value_ptr(mvp));
-	shader.useProgram();
-
-	if (alphaBlend)
+	shader->registerUniform1i("texture", 0);
+	if (paletteTexID != 0)
 	{
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		const int PALETTE_UNIT = 1;
+		glBindTextureUnit(PALETTE_UNIT, paletteTexID);
+		shader->registerUniform1i("palette", PALETTE_UNIT);
 	}
-	else
+	shader->useProgram();
+
+	shader->registerUniform1f("additive", additiveFactor(blendMode));
+	if (blendMode == BlendMode::Opaque)
 	{
-		glDisable(GL_BLEND);
+		shader->registerUniform1f("alphaCutoff", alphaCutoff(blendMode));
 	}
+	applyBlendMode(blendMode);
 
 	glBindVertexArray(vaoID);
 	glBindBuffer(GL_ARRAY_BUFFER, vboIDs[SPRITE_VBO_ATTR_POS]);
@@ -75,10 +86,12 @@ void Sprite::draw(SDL_Window* w, Camera* cam)
 	glBindBuffer(GL_ARRAY_BUFFER, vboIDs[SPRITE_VBO_ATTR_UV]);
 	glVertexAttribPointer(SPRITE_VBO_ATTR_UV, SPRITE_FLOATS_PER_UV, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(SPRITE_VBO_ATTR_UV);
+	enableDrawIDAttribute(gFrameData);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboID);
 
+	// The base instance selects this sprite's DrawData entry
 	//glDrawArrays(GL_TRIANGLES, 0, NUM_SPRITE_TRIANGLES_VERT_COUNT);
-	glDrawElements(GL_TRIANGLES, NUM_SPRITE_TRIANGLES_IDX_COUNT, GL_UNSIGNED_INT, nullptr);
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, numIndexes, GL_UNSIGNED_INT, nullptr, 1, drawIndex);
 	//glDrawArrays(GL_TRIANGLES, 0, NUM_SPRITE_TRIANGLES_VERT_COUNT);
 }
 
@@ -90,34 +103,58 @@ void Sprite::cleanup()
 	glDeleteBuffers(1, &eboID);
 	glDeleteVertexArrays(NUM_SPRITE_VAO, &vaoID);
 	glDeleteSamplers(1, &samplerID);
+	releaseTexture(texHandle, gTextures);
+}
+
+DrawSortInfo Sprite::getSortInfo() const
+{
+	return DrawSortInfo{ layer, blendMode != BlendMode::Opaque, getShaderVariantID(shaderName, spriteShaderFeatures(*this), shaderVariant), texID, 0.0f };
+}
+
+bool Sprite::getDrawData(DrawData& data) const
+{
+	data.model = buildModelMatrix(pos, angle, scale);
+	return true;
+}
+
+bool Sprite::getBounds(Bounds2D& bounds) const
+{
+	if (numIndexes == 0) return false;
+
+	// Follows pos/scale/angle as they are edited, same transform as draw()
+	bounds = transformBounds(localBounds, pos, scale, angle);
+	return true;
+}
+
+// Hull points are in frame space, (0,0) at the bottom left of the frame
+static void fillGeometry(Sprite& sprite)
+{
+	float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+	const Texture* tex = getTexture(sprite.texHandle, gTextures);
+	if (!sprite.clipRect.empty() && tex != nullptr)
+	{
+		u0 = sprite.clipRect.x / tex->width;
+		v0 = sprite.clipRect.y / tex->height;
+		u1 = u0 + sprite.clipRect.w / tex->width;
+		v1 = v0 + sprite.clipRect.h / tex->height;
+	}
+
+	const std::vector<glm::vec2>& points = sprite.hull.points;
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		sprite.vertices[i][0] = points[i].x * sprite.width - sprite.pivot.x;
+		sprite.vertices[i][1] = points[i].y * sprite.height - sprite.pivot.y;
+		// v = 0 is the top of the texture
+		sprite.uvs[i][0] = u0 + points[i].x * (u1 - u0);
+		sprite.uvs[i][1] = v1 - points[i].y * (v1 - v0);
+	}
+	sprite.numIndexes = buildHullIndexes((int)points.size(), sprite.indexes);
+	computeBounds(&sprite.vertices[0][0], points.size(), sprite.localBounds);
 }
 
 void initGeometry(Sprite& sprite)
 {
-	sprite.vertices[0][0] = -sprite.pivot.x;
-	sprite.vertices[0][1] = -sprite.pivot.y;
-	sprite.vertices[1][0] = sprite.width - sprite.pivot.x;
-	sprite.vertices[1][1] = sprite.height - sprite.pivot.y;
-	sprite.vertices[2][0] = -sprite.pivot.x;
-	sprite.vertices[2][1] = sprite.height - sprite.pivot.y;
-	sprite.vertices[3][0] = sprite.width - sprite.pivot.x;
-	sprite.vertices[3][1] = -sprite.pivot.y;
-
-	sprite.indexes[0] = 0;
-	sprite.indexes[1] = 1;
-	sprite.indexes[2] = 2;
-	sprite.indexes[3] = 0;
-	sprite.indexes[4] = 3;
-	sprite.indexes[5] = 1;
-
-	sprite.uvs[0][0] = 0.0f;
-	sprite.uvs[0][1] = 1.0f;
-	sprite.uvs[1][0] = 1.0f;
-	sprite.uvs[1][1] = 0.0f;
-	sprite.uvs[2][0] = 0.0f;
-	sprite.uvs[2][1] = 0.0f;
-	sprite.uvs[3][0] = 1.0f;
-	sprite.uvs[3][1] = 1.0f;
+	fillGeometry(sprite);
 
 	glCreateVertexArrays(NUM_SPRITE_VAO, &(sprite.vaoID));
 	glBindVertexArray(sprite.vaoID); // current vtex array
@@ -144,7 +181,7 @@ void initGeometry(Sprite& sprite)
 	// Indexes
 	glCreateBuffers(1, &sprite.eboID);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sprite.eboID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (NUM_SPRITE_TRIANGLES_IDX_COUNT) * sizeof(GLuint), sprite.indexes, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (NUM_SPRITE_TRIANGLES_IDX_COUNT) * sizeof(GLuint), sprite.indexes, GL_DYNAMIC_DRAW);
 
 
 }
@@ -152,55 +189,11 @@ void initGeometry(Sprite& sprite)
 
 void updateGeometry(Sprite& sprite)
 {
-	sprite.vertices[0][0] = -sprite.pivot.x;
-	sprite.vertices[0][1] = -sprite.pivot.y;
-	sprite.vertices[1][0] = sprite.width - sprite.pivot.x;
-	sprite.vertices[1][1] = sprite.height - sprite.pivot.y;
-	sprite.vertices[2][0] = -sprite.pivot.x;
-	sprite.vertices[2][1] = sprite.height - sprite.pivot.y;
-	sprite.vertices[3][0] = sprite.width - sprite.pivot.x;
-	sprite.vertices[3][1] = -sprite.pivot.y;
-
-	glBindVertexArray(sprite.vaoID); // current vtex array
-									  // pos
-	glBindBuffer(GL_ARRAY_BUFFER, sprite.vboIDs[SPRITE_VBO_ATTR_POS]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sprite.vertices), sprite.vertices);
-	glVertexAttribPointer(SPRITE_VBO_ATTR_POS, SPRITE_FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, 0, 0); // Coord. info => Atr. index #0, three floats/vtx
+	fillGeometry(sprite);
 
-
-	if (!sprite.clipRect.empty())
-	{
-		Texture tex = gTextures[sprite.texPath];
-		float clipX1Ratio = sprite.clipRect.x / tex.width;
-		float clipY1Ratio = sprite.clipRect.y / tex.height;
-		float clipX2Ratio = clipX1Ratio + sprite.clipRect.w / tex.width;
-		float clipY2Ratio = clipY1Ratio + sprite.clipRect.h / tex.height;
-		sprite.uvs[0][0] = clipX1Ratio;
-		sprite.uvs[0][1] = clipY2Ratio;
-		sprite.uvs[1][0] = clipX2Ratio;
-		sprite.uvs[1][1] = clipY1Ratio;
-		sprite.uvs[2][0] = clipX1Ratio;
-		sprite.uvs[2][1] = clipY1Ratio;
-		sprite.uvs[3][0] = clipX2Ratio;
-		sprite.uvs[3][1] = clipY2Ratio;
-	}
-	else
-	{
-		sprite.uvs[0][0] = 0.0f;
-		sprite.uvs[0][1] = 1.0f;
-		sprite.uvs[1][0] = 1.0f;
-		sprite.uvs[1][1] = 0.0f;
-		sprite.uvs[2][0] = 0.0f;
-		sprite.uvs[2][1] = 0.0f;
-		sprite.uvs[3][0] = 1.0f;
-		sprite.uvs[3][1] = 1.0f;
-	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, sprite.vboIDs[SPRITE_VBO_ATTR_UV]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sprite.uvs), sprite.uvs);
-	glVertexAttribPointer(SPRITE_VBO_ATTR_UV, SPRITE_FLOATS_PER_UV, GL_FLOAT, GL_FALSE, 0, 0); // Coord. info => Atr. index #0, three floats/vtx
-
-																							   //Indexes will not change
+	glNamedBufferSubData(sprite.vboIDs[SPRITE_VBO_ATTR_POS], 0, sizeof(sprite.vertices), sprite.vertices);
+	glNamedBufferSubData(sprite.vboIDs[SPRITE_VBO_ATTR_UV], 0, sizeof(sprite.uvs), sprite.uvs);
+	glNamedBufferSubData(sprite.eboID, 0, sprite.numIndexes * sizeof(GLuint), sprite.indexes);
 }
 
 void setCustomPivot(Sprite& sprite, glm::vec2* pivot, bool update)
@@ -211,43 +204,43 @@ void setCustomPivot(Sprite& sprite, glm::vec2* pivot, bool update)
 		updateGeometry(sprite);
 }
 
-void setPivotType(Sprite& sprite, PivotType pivotType, bool update)
+glm::vec2 getPivotPoint(PivotType pivotType, float width, float height)
 {
 	glm::vec2 v = { 0.0f, 0.0f };
 	switch (pivotType)
 	{
 	case PivotType::TopLeft:
 	{
-		v.y = sprite.height;
+		v.y = height;
 		break;
 	}
 	case PivotType::Top:
 	{
-		v.x = sprite.width * 0.5f;
-		v.y = sprite.height;
+		v.x = width * 0.5f;
+		v.y = height;
 		break;
 	}
 	case PivotType::TopRight:
 	{
-		v.x = sprite.width;
-		v.y = sprite.height;
+		v.x = width;
+		v.y = height;
 		break;
 	}
 	case PivotType::CentreLeft:
 	{
-		v.y = sprite.height * 0.5f;
+		v.y = height * 0.5f;
 		break;
 	}
 	case PivotType::Centre:
 	{
-		v.x = sprite.width * 0.5f;
-		v.y = sprite.height * 0.5f;
+		v.x = width * 0.5f;
+		v.y = height * 0.5f;
 		break;
 	}
 	case PivotType::CentreRight:
 	{
-		v.x = sprite.width;
-		v.y = sprite.height * 0.5f;
+		v.x = width;
+		v.y = height * 0.5f;
 		break;
 	}
 	case PivotType::BotLeft:
@@ -256,43 +249,102 @@ void setPivotType(Sprite& sprite, PivotType pivotType, bool update)
 	}
 	case PivotType::Bottom:
 	{
-		v.x = sprite.width * 0.5f;
+		v.x = width * 0.5f;
 		break;
 	}
 	case PivotType::BotRight:
 	{
-		v.x = sprite.width;
+		v.x = width;
 		break;
 	}
 	default:
 		break;
 	}
+	return v;
+}
+
+void setPivotType(Sprite& sprite, PivotType pivotType, bool update)
+{
+	glm::vec2 v = getPivotPoint(pivotType, sprite.width, sprite.height);
 	setCustomPivot(sprite, &v, update);
 }
+bool setPaletteVariant(Sprite& sprite, int variant)
+{
+	const Texture* tex = getTexture(sprite.texHandle, gTextures);
+	if (tex == nullptr || !tex->paletted)
+	{
+		sprite.paletteTexID = 0;
+		return false;
+	}
+	if (variant < 0 || variant >= (int)tex->paletteIDs.size())
+	{
+		logError("Palette variant out of range");
+		return false;
+	}
+
+	// A non zero palette switches the sprite to the PALETTED variant
+	sprite.paletteTexID = tex->paletteIDs[variant];
+	return true;
+}
+
+bool buildSpriteHull(Sprite& sprite, int maxVertices)
+{
+	const Texture* tex = getTexture(sprite.texHandle, gTextures);
+	if (tex == nullptr || tex->paletted)
+	{
+		logError("Sprite:: hulls need a truecolour texture");
+		return false;
+	}
+	SDL_Surface* surface = loadSurfaceRGBA(sprite.texPath);
+	if (surface == nullptr) return false;
+
+	Rect frame = sprite.clipRect;
+	if (frame.empty())
+	{
+		frame.x = frame.y = 0.0f;
+		frame.w = (float)surface->w;
+		frame.h = (float)surface->h;
+	}
+	if (!frameInsideImage(frame, surface->w, surface->h))
+	{
+		logError("Sprite:: clip rect is outside the texture");
+		SDL_FreeSurface(surface);
+		return false;
+	}
+	// The vertex and index arrays only have room for SPRITE_HULL_MAX_VERTICES
+	maxVertices = std::min(maxVertices, SPRITE_HULL_MAX_VERTICES);
+	buildSpriteHull((const uint8_t*)surface->pixels, surface->pitch, frame, maxVertices, SPRITE_HULL_ALPHA_THRESHOLD, sprite.hull);
+	SDL_FreeSurface(surface);
+
+	std::ostringstream sstream;
+	sstream << "Sprite " << sprite.name << ": " << sprite.hull.points.size() << " vertex hull covers " << (int)(sprite.hull.coverage * 100.0f) << "% of the quad";
+	logInfo(sstream.str().c_str());
+
+	updateGeometry(sprite);
+	return true;
+}
+
 void initSprite(Sprite& sprite, const std::string& texPath, const std::string& shaderName)
 {
 	sprite.texPath = texPath;
 	sprite.shaderName = shaderName;
-	unsigned int texWidth;
-	unsigned int texHeight;
-	loadTexture(sprite.texPath, sprite.texID, texWidth, texHeight, gTextures);
+	unsigned int texWidth = 0;
+	unsigned int texHeight = 0;
+	if (loadTexture(sprite.texPath, sprite.texHandle, gTextures))
+	{
+		const Texture* tex = getTexture(sprite.texHandle, gTextures);
+		sprite.texID = tex->texID;
+		texWidth = tex->width;
+		texHeight = tex->height;
+	}
 
 	sprite.width = (float)texWidth;
 	sprite.height = (float)texHeight;
 
 	setPivotType(sprite, PivotType::Custom, false);
+	setPaletteVariant(sprite, 0);
 
 	initGeometry(sprite);
-
-	TShaderTableIter it = gShaders.find(sprite.shaderName);
-	if (it == gShaders.end())
-	{
-		logError("Shader not found!!");
-	}
-	else
-	{
-		sprite.shaderID = it->second.GetShaderID();
-	}
 	glCreateSamplers(1, &sprite.samplerID);
 }
 
@@ -300,25 +352,17 @@ void initSprite(Sprite& sprite, const std::string& texPath, const std::string& s
 {
 	sprite.texPath = texPath;
 	sprite.shaderName = shaderName;
-	unsigned int texWidth;
-	unsigned int texHeight;
-	loadTexture(sprite.texPath, sprite.texID, texWidth, texHeight, gTextures);
+	if (loadTexture(sprite.texPath, sprite.texHandle, gTextures))
+	{
+		sprite.texID = getTexture(sprite.texHandle, gTextures)->texID;
+	}
 
 	sprite.width = w;
 	sprite.height = h;
 
 	setPivotType(sprite, PivotType::Custom, false);
+	setPaletteVariant(sprite, 0);
 
 	initGeometry(sprite);
-
-	TShaderTableIter it = gShaders.find(sprite.shaderName);
-	if (it == gShaders.end())
-	{
-		logError("Shader not found!!");
-	}
-	else
-	{
-		sprite.shaderID = it->second.GetShaderID();
-	}
 	glCreateSamplers(1, &sprite.samplerID);
 }
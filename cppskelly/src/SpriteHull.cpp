@@ -0,0 +1,155 @@
+#include "SpriteHull.h"
+#include <algorithm>
+
+static float cross2(const glm::vec2& a, const glm::vec2& b)
+{
+	return a.x * b.y - a.y * b.x;
+}
+
+float polygonArea(const std::vector<glm::vec2>& points)
+{
+	float area = 0.0f;
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		area += cross2(points[i], points[(i + 1) % points.size()]);
+	}
+	return area * 0.5f;
+}
+
+void setUnitQuadHull(SpriteHull& hull)
+{
+	hull.points = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+	hull.coverage = 1.0f;
+}
+
+// Andrew's monotone chain, counter-clockwise, collinear points dropped
+static void convexHull(std::vector<glm::vec2>& points, std::vector<glm::vec2>& hull)
+{
+	std::sort(points.begin(), points.end(), [](const glm::vec2& a, const glm::vec2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+	points.erase(std::unique(points.begin(), points.end()), points.end());
+
+	hull.assign(points.size() * 2, glm::vec2());
+	size_t n = 0;
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		while (n >= 2 && cross2(hull[n - 1] - hull[n - 2], points[i] - hull[n - 2]) <= 0.0f) --n;
+		hull[n++] = points[i];
+	}
+	for (size_t i = points.size() - 1, lower = n + 1; i-- > 0;)
+	{
+		while (n >= lower && cross2(hull[n - 1] - hull[n - 2], points[i] - hull[n - 2]) <= 0.0f) --n;
+		hull[n++] = points[i];
+	}
+	hull.resize(n > 1 ? n - 1 : n);
+}
+
+// Removes the edge whose neighbours, extended until they meet, add the least
+// area. The result still contains the old hull, so nothing visible is lost.
+static bool removeCheapestEdge(std::vector<glm::vec2>& hull)
+{
+	const float EPSILON = 1e-5f;
+	const size_t n = hull.size();
+	size_t best = n;
+	float bestArea = 0.0f;
+	glm::vec2 bestPoint;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const glm::vec2& prev = hull[(i + n - 1) % n];
+		const glm::vec2& a = hull[i];
+		const glm::vec2& b = hull[(i + 1) % n];
+		const glm::vec2& next = hull[(i + 2) % n];
+
+		glm::vec2 d1 = a - prev;
+		glm::vec2 d2 = next - b;
+		float denom = cross2(d1, d2);
+		if (denom <= EPSILON) continue; // Edges don't converge ahead
+
+		float t = cross2(b - a, d2) / denom;
+		glm::vec2 q = a + d1 * t;
+		if (q.x < -EPSILON || q.y < -EPSILON || q.x > 1.0f + EPSILON || q.y > 1.0f + EPSILON) continue;
+
+		float added = 0.5f * std::abs(cross2(b - a, q - a));
+		if (best == n || added < bestArea)
+		{
+			best = i;
+			bestArea = added;
+			bestPoint = glm::clamp(q, 0.0f, 1.0f);
+		}
+	}
+	if (best == n) return false;
+
+	hull[best] = bestPoint;
+	hull.erase(hull.begin() + (best + 1) % n);
+	return true;
+}
+
+void buildSpriteHull(const uint8_t* pixels, int pitch, const Rect& frame, int maxVertices, uint8_t alphaThreshold, SpriteHull& hull)
+{
+	hull.points.clear();
+	hull.coverage = 0.0f;
+
+	const int x0 = (int)frame.x;
+	const int y0 = (int)frame.y;
+	const int w = (int)frame.w;
+	const int h = (int)frame.h;
+	if (w <= 0 || h <= 0) return;
+
+	// Outer corners of the first and last visible texel on each row
+	std::vector<glm::vec2> points;
+	for (int y = 0; y < h; ++y)
+	{
+		const uint8_t* row = pixels + (size_t)(y0 + y) * pitch + (size_t)x0 * 4;
+		int first = -1;
+		int last = -1;
+		for (int x = 0; x < w; ++x)
+		{
+			if (row[x * 4 + 3] > alphaThreshold)
+			{
+				if (first < 0) first = x;
+				last = x;
+			}
+		}
+		if (first < 0) continue;
+
+		float top = 1.0f - y / (float)h;
+		float bottom = 1.0f - (y + 1) / (float)h;
+		float left = first / (float)w;
+		float right = (last + 1) / (float)w;
+		points.push_back({ left, top });
+		points.push_back({ left, bottom });
+		points.push_back({ right, top });
+		points.push_back({ right, bottom });
+	}
+	if (points.empty()) return;
+
+	convexHull(points, hull.points);
+	maxVertices = std::max(maxVertices, 4);
+	while ((int)hull.points.size() > maxVertices)
+	{
+		if (!removeCheapestEdge(hull.points))
+		{
+			// Boxed in by the frame edges: the bounding box always fits
+			glm::vec2 lo(1.0f), hi(0.0f);
+			for (const glm::vec2& p : hull.points)
+			{
+				lo = glm::min(lo, p);
+				hi = glm::max(hi, p);
+			}
+			hull.points = { lo, { hi.x, lo.y }, hi, { lo.x, hi.y } };
+			break;
+		}
+	}
+	hull.coverage = polygonArea(hull.points);
+}
+
+int buildHullIndexes(int numPoints, uint32_t* indexes)
+{
+	int count = 0;
+	for (int i = 1; i + 1 < numPoints; ++i)
+	{
+		indexes[count++] = 0;
+		indexes[count++] = i;
+		indexes[count++] = i + 1;
+	}
+	return count;
+}
@@ -0,0 +1,424 @@
+#include "StreamingTilemap.h"
+#include "Camera.h"
+#include "Shader.h"
+#include "logUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static const char TILEMAP_FILE_MAGIC[4] = { 'S', 'K', 'T', 'M' };
+static const uint32_t NO_CHUNK = 0xffffffff;
+
+struct ChunkRange
+{
+	int minX, minY, maxX, maxY;
+
+	inline bool contains(int x, int y) const
+	{
+		return x >= minX && x <= maxX && y >= minY && y <= maxY;
+	}
+};
+
+static size_t chunkOffset(const TilemapFileHeader& header, uint32_t chunkIndex)
+{
+	return sizeof(TilemapFileHeader) + (size_t)chunkIndex * header.chunkSize * header.chunkSize * sizeof(uint16_t);
+}
+
+bool writeTilemapFile(const std::string& path, int width, int height, const std::function<uint16_t(int, int)>& tileAt)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		std::ostringstream sstream;
+		sstream << "writeTilemapFile:: could not create " << path.c_str();
+		logError(sstream.str().c_str());
+		return false;
+	}
+
+	TilemapFileHeader header;
+	memcpy(header.magic, TILEMAP_FILE_MAGIC, sizeof(header.magic));
+	header.version = TILEMAP_FILE_VERSION;
+	header.width = width;
+	header.height = height;
+	header.chunkSize = TILEMAP_CHUNK_SIZE;
+	header.chunksX = (width + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+	header.chunksY = (height + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+	header.reserved = 0;
+	out.write((const char*)&header, sizeof(header));
+
+	// Written a chunk at a time, the whole map never needs to be in memory
+	std::vector<uint16_t> chunk(TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE);
+	for (uint32_t cy = 0; cy < header.chunksY; ++cy)
+	{
+		for (uint32_t cx = 0; cx < header.chunksX; ++cx)
+		{
+			for (int y = 0; y < TILEMAP_CHUNK_SIZE; ++y)
+			{
+				for (int x = 0; x < TILEMAP_CHUNK_SIZE; ++x)
+				{
+					int tileX = cx * TILEMAP_CHUNK_SIZE + x;
+					int tileY = cy * TILEMAP_CHUNK_SIZE + y;
+					chunk[y * TILEMAP_CHUNK_SIZE + x] = (tileX < width && tileY < height) ? tileAt(tileX, tileY) : TILE_EMPTY;
+				}
+			}
+			out.write((const char*)chunk.data(), chunk.size() * sizeof(uint16_t));
+		}
+	}
+	return (bool)out;
+}
+
+StreamingTilemap::StreamingTilemap(const std::string& name)
+	:name(name)
+	, shaderName()
+	, tileset()
+	, samplerID(0), shaderVariant()
+	, tileSize(1.0f, 1.0f), origin()
+	, header()
+	, eboID(0)
+	, blendMode(BlendMode::Opaque)
+	, prefetchMargin(1), lookahead(3), releaseMargin(2)
+	, maxUploadsPerFrame(4), maxFreeChunks(32)
+	, lastViewCentre(), hasLastView(false)
+	, building(NO_CHUNK), stopWorker(false)
+	, visibleChunks(0), uploadedChunks(0), releasedChunks(0)
+{}
+
+static void buildChunkMesh(const StreamingTilemap& map, uint32_t chunkIndex, ChunkMesh& mesh)
+{
+	const TilemapFileHeader& header = map.header;
+	int chunkX = chunkIndex % header.chunksX;
+	int chunkY = chunkIndex / header.chunksX;
+	int firstX = chunkX * header.chunkSize;
+	int firstY = chunkY * header.chunkSize;
+	int blockWidth = std::min((int)header.chunkSize, (int)header.width - firstX);
+	int blockHeight = std::min((int)header.chunkSize, (int)header.height - firstY);
+	glm::vec2 blockOrigin = map.origin + glm::vec2(firstX * map.tileSize.x, firstY * map.tileSize.y);
+
+	// Page faults on the mapping happen here, off the render thread
+	const uint16_t* tiles = (const uint16_t*)(map.file.data + chunkOffset(header, chunkIndex));
+	mesh.chunkIndex = chunkIndex;
+	mesh.vertices.clear();
+	mesh.numQuads = buildTileQuads(tiles, blockWidth, blockHeight, header.chunkSize, blockOrigin, map.tileSize, map.tileset, mesh.vertices);
+}
+
+static void streamChunks(StreamingTilemap* map)
+{
+	const size_t chunkBytes = (size_t)map->header.chunkSize * map->header.chunkSize * sizeof(uint16_t);
+
+	std::unique_lock<std::mutex> lock(map->mutex);
+	while (true)
+	{
+		map->wake.wait(lock, [map] { return map->stopWorker || !map->requests.empty(); });
+		if (map->stopWorker) break;
+
+		uint32_t chunkIndex = map->requests.front();
+		map->requests.pop_front();
+		uint32_t next = map->requests.empty() ? NO_CHUNK : map->requests.front();
+		map->building = chunkIndex;
+		lock.unlock();
+
+		// Let the OS read the next chunk in while this one is meshed
+		if (next != NO_CHUNK)
+		{
+			adviseMappedRange(map->file, chunkOffset(map->header, next), chunkBytes, true);
+		}
+
+		ChunkMesh mesh;
+		buildChunkMesh(*map, chunkIndex, mesh);
+
+		lock.lock();
+		map->building = NO_CHUNK;
+		map->ready.push_back(std::move(mesh));
+	}
+}
+
+// Everything the worker later indexes with comes from the file, so it's all
+// checked here: products are done in 64 bits so a crafted header can't wrap
+// its way past the size check.
+static bool isValidTilemapHeader(const TilemapFileHeader& header, size_t fileSize)
+{
+	const uint32_t MAX_CHUNK_SIZE = 256;
+	if (memcmp(header.magic, TILEMAP_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != TILEMAP_FILE_VERSION)
+	{
+		return false;
+	}
+	if (header.chunkSize == 0 || header.chunkSize > MAX_CHUNK_SIZE
+		|| (uint64_t)header.chunkSize * header.chunkSize > (uint64_t)TILEMAP_MAX_QUADS_PER_CHUNK)
+	{
+		return false;
+	}
+	if (header.width == 0 || header.height == 0 || header.width > INT32_MAX || header.height > INT32_MAX)
+	{
+		return false;
+	}
+
+	// Chunks must cover the map exactly, or a block could run past its chunk's tiles
+	const uint64_t chunksX = ((uint64_t)header.width + header.chunkSize - 1) / header.chunkSize;
+	const uint64_t chunksY = ((uint64_t)header.height + header.chunkSize - 1) / header.chunkSize;
+	if (header.chunksX != chunksX || header.chunksY != chunksY)
+	{
+		return false;
+	}
+
+	const uint64_t numChunks = chunksX * chunksY;
+	const uint64_t chunkBytes = (uint64_t)header.chunkSize * header.chunkSize * sizeof(uint16_t);
+	return numChunks < NO_CHUNK
+		&& (fileSize - sizeof(TilemapFileHeader)) / chunkBytes >= numChunks;
+}
+
+bool initStreamingTilemap(StreamingTilemap& map, const std::string& mapPath, const std::string& texPath, const std::string& shaderName, int sheetTileWidth, int sheetTileHeight, const glm::vec2& tileSize)
+{
+	if (!openMappedFile(mapPath, map.file))
+	{
+		return false;
+	}
+
+	bool valid = map.file.size >= sizeof(TilemapFileHeader);
+	if (valid)
+	{
+		memcpy(&map.header, map.file.data, sizeof(TilemapFileHeader));
+		valid = isValidTilemapHeader(map.header, map.file.size);
+	}
+	if (!valid)
+	{
+		std::ostringstream sstream;
+		sstream << "StreamingTilemap:: " << mapPath.c_str() << " is not a valid map file";
+		logError(sstream.str().c_str());
+		closeMappedFile(map.file);
+		return false;
+	}
+
+	if (!initTileset(map.tileset, texPath, sheetTileWidth, sheetTileHeight))
+	{
+		logError("StreamingTilemap:: could not load the tilesheet");
+		closeMappedFile(map.file);
+		return false;
+	}
+
+	map.shaderName = shaderName;
+	map.tileSize = tileSize;
+	map.eboID = createTileIndexBuffer();
+
+	glCreateSamplers(1, &map.samplerID);
+	glSamplerParameteri(map.samplerID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(map.samplerID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glSamplerParameteri(map.samplerID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(map.samplerID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	map.stopWorker = false;
+	map.worker = std::thread(streamChunks, &map);
+	return true;
+}
+
+static ChunkRange clampRange(const ChunkRange& range, const TilemapFileHeader& header)
+{
+	ChunkRange clamped;
+	clamped.minX = std::max(range.minX, 0);
+	clamped.minY = std::max(range.minY, 0);
+	clamped.maxX = std::min(range.maxX, (int)header.chunksX - 1);
+	clamped.maxY = std::min(range.maxY, (int)header.chunksY - 1);
+	return clamped;
+}
+
+static void releaseChunk(StreamingTilemap& map, uint32_t chunkIndex, TilemapChunk& chunk)
+{
+	if ((int)map.freeChunks.size() < map.maxFreeChunks)
+	{
+		map.freeChunks.push_back(chunk);
+	}
+	else
+	{
+		cleanupChunk(chunk);
+	}
+
+	const size_t chunkBytes = (size_t)map.header.chunkSize * map.header.chunkSize * sizeof(uint16_t);
+	adviseMappedRange(map.file, chunkOffset(map.header, chunkIndex), chunkBytes, false);
+}
+
+void StreamingTilemap::draw(SDL_Window* w, Camera* c)
+{
+	visibleChunks = 0;
+	uploadedChunks = 0;
+	releasedChunks = 0;
+
+	glm::vec2 viewMin, viewMax;
+	if (!file.data || !getViewBounds(c, 0.0f, viewMin, viewMax)) return;
+
+	glm::vec2 chunkExtent = tileSize * (float)header.chunkSize;
+	ChunkRange view;
+	view.minX = (int)std::floor((viewMin.x - origin.x) / chunkExtent.x);
+	view.minY = (int)std::floor((viewMin.y - origin.y) / chunkExtent.y);
+	view.maxX = (int)std::floor((viewMax.x - origin.x) / chunkExtent.x);
+	view.maxY = (int)std::floor((viewMax.y - origin.y) / chunkExtent.y);
+
+	glm::vec2 centre = (viewMin + viewMax) * 0.5f;
+	glm::vec2 motion = hasLastView ? centre - lastViewCentre : glm::vec2(0.0f);
+	lastViewCentre = centre;
+	hasLastView = true;
+
+	// Prefetch around the view, further out on the side we're moving towards
+	ChunkRange prefetch = { view.minX - prefetchMargin, view.minY - prefetchMargin, view.maxX + prefetchMargin, view.maxY + prefetchMargin };
+	if (motion.x > 0.0f) prefetch.maxX += lookahead;
+	else if (motion.x < 0.0f) prefetch.minX -= lookahead;
+	if (motion.y > 0.0f) prefetch.maxY += lookahead;
+	else if (motion.y < 0.0f) prefetch.minY -= lookahead;
+
+	ChunkRange keep = { prefetch.minX - releaseMargin, prefetch.minY - releaseMargin, prefetch.maxX + releaseMargin, prefetch.maxY + releaseMargin };
+	view = clampRange(view, header);
+	prefetch = clampRange(prefetch, header);
+
+	for (auto it = resident.begin(); it != resident.end();)
+	{
+		int x = it->first % header.chunksX;
+		int y = it->first / header.chunksX;
+		if (keep.contains(x, y))
+		{
+			++it;
+			continue;
+		}
+		releaseChunk(*this, it->first, it->second);
+		it = resident.erase(it);
+		++releasedChunks;
+	}
+
+	// Visible chunks first, then the prefetch area closest to where we're headed
+	std::vector<uint32_t> wanted;
+	std::vector<std::pair<float, uint32_t>> ahead;
+	glm::vec2 focus = glm::vec2((view.minX + view.maxX) * 0.5f, (view.minY + view.maxY) * 0.5f);
+	float motionLength = glm::length(motion);
+	if (motionLength > 0.0f)
+	{
+		focus += motion / motionLength * (float)lookahead;
+	}
+	for (int y = prefetch.minY; y <= prefetch.maxY; ++y)
+	{
+		for (int x = prefetch.minX; x <= prefetch.maxX; ++x)
+		{
+			uint32_t index = y * header.chunksX + x;
+			if (resident.count(index) != 0) continue;
+
+			if (view.contains(x, y))
+			{
+				wanted.push_back(index);
+			}
+			else
+			{
+				glm::vec2 offset = glm::vec2((float)x, (float)y) - focus;
+				ahead.push_back(std::make_pair(glm::dot(offset, offset), index));
+			}
+		}
+	}
+	std::sort(ahead.begin(), ahead.end());
+	for (const auto& entry : ahead)
+	{
+		wanted.push_back(entry.second);
+	}
+
+	std::vector<ChunkMesh> uploads;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Meshes for chunks we've moved away from are no longer worth uploading
+		ready.erase(std::remove_if(ready.begin(), ready.end(), [this, &keep](const ChunkMesh& mesh)
+		{
+			return !keep.contains(mesh.chunkIndex % header.chunksX, mesh.chunkIndex / header.chunksX);
+		}), ready.end());
+
+		requests.clear();
+		for (uint32_t index : wanted)
+		{
+			bool inFlight = index == building;
+			for (size_t i = 0; i < ready.size() && !inFlight; ++i)
+			{
+				inFlight = ready[i].chunkIndex == index;
+			}
+			if (!inFlight)
+			{
+				requests.push_back(index);
+			}
+		}
+
+		// Bounded per frame so a burst of finished chunks can't cause a hitch
+		size_t numUploads = std::min(ready.size(), (size_t)maxUploadsPerFrame);
+		uploads.reserve(numUploads);
+		for (size_t i = 0; i < numUploads; ++i)
+		{
+			uploads.push_back(std::move(ready[i]));
+		}
+		ready.erase(ready.begin(), ready.begin() + numUploads);
+	}
+	wake.notify_one();
+
+	for (ChunkMesh& mesh : uploads)
+	{
+		if (resident.count(mesh.chunkIndex) != 0) continue;
+
+		TilemapChunk chunk;
+		if (!freeChunks.empty())
+		{
+			chunk = freeChunks.back();
+			freeChunks.pop_back();
+		}
+		uploadChunk(chunk, mesh.vertices, mesh.numQuads, eboID);
+		resident[mesh.chunkIndex] = chunk;
+		++uploadedChunks;
+	}
+
+	if (!beginTilemapDraw(shaderName, shaderVariant, tileset, samplerID, blendMode, c)) return;
+
+	for (int y = view.minY; y <= view.maxY; ++y)
+	{
+		for (int x = view.minX; x <= view.maxX; ++x)
+		{
+			auto it = resident.find(y * header.chunksX + x);
+			if (it == resident.end() || it->second.numQuads == 0) continue;
+
+			drawChunk(it->second);
+			++visibleChunks;
+		}
+	}
+}
+
+void StreamingTilemap::cleanup()
+{
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopWorker = true;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+
+	for (auto& entry : resident)
+	{
+		cleanupChunk(entry.second);
+	}
+	resident.clear();
+	for (TilemapChunk& chunk : freeChunks)
+	{
+		cleanupChunk(chunk);
+	}
+	freeChunks.clear();
+	ready.clear();
+
+	glDeleteBuffers(1, &eboID);
+	glDeleteSamplers(1, &samplerID);
+	releaseTexture(tileset.texHandle, gTextures);
+	closeMappedFile(file);
+}
+
+DrawSortInfo StreamingTilemap::getSortInfo() const
+{
+	return DrawSortInfo{ layer, blendMode != BlendMode::Opaque, getShaderVariantID(shaderName, tilemapShaderFeatures(tileset, blendMode), shaderVariant), tileset.texID, 1.0f };
+}
+
+bool StreamingTilemap::getBounds(Bounds2D& bounds) const
+{
+	bounds.minPos = origin;
+	bounds.maxPos = origin + glm::vec2((int)header.width * tileSize.x, (int)header.height * tileSize.y);
+	return true;
+}
@@ -0,0 +1,454 @@
+#include "TentacleSystem.h"
+#include "Camera.h"
+#include "FrameData.h"
+#include "FramePacket.h"
+#include "JobSystem.h"
+#include "Line.h"
+#include "logUtils.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <mutex>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TENTACLES_SSE2
+#include <emmintrin.h>
+#endif
+
+static const int TENTACLE_ATTR_POS = 0;
+static const int TENTACLE_ATTR_COLOUR = 2; // basic.vert's VERTEX_COLOUR input
+static const GLuint TENTACLE_RESTART_INDEX = 0xffffffff;
+
+// Enough per job to amortise the scheduling, small enough to balance 100k over many cores
+static const size_t TENTACLES_PER_JOB = 256;
+
+static const float PI = 3.14159265358979f;
+static const float TWO_PI = 6.28318530717959f;
+static const float INV_TWO_PI = 0.159154943091895f;
+static const float TWO_OVER_PI = 0.636619772367581f;
+// pi/2 split so j * each part is exact for the quadrant counts we see
+static const float HALF_PI_1 = 1.5703125f;
+static const float HALF_PI_2 = 4.837512969970703125e-4f;
+static const float HALF_PI_3 = 7.54978995489188216e-8f;
+// Minimax sin and cos on [-pi/4, pi/4]
+static const float SIN_1 = -1.6666654611e-1f;
+static const float SIN_2 = 8.3321608736e-3f;
+static const float SIN_3 = -1.9515295891e-4f;
+static const float COS_1 = 4.166664568298827e-2f;
+static const float COS_2 = -1.388731625493765e-3f;
+static const float COS_3 = 2.443315711809948e-5f;
+
+void fastSinCos(float x, float& s, float& c)
+{
+	float fj = std::floor(x * TWO_OVER_PI + 0.5f);
+	int j = (int)fj;
+	float r = ((x - fj * HALF_PI_1) - fj * HALF_PI_2) - fj * HALF_PI_3;
+	float r2 = r * r;
+	float sinR = r + r * r2 * (SIN_1 + r2 * (SIN_2 + r2 * SIN_3));
+	float cosR = 1.0f - 0.5f * r2 + r2 * r2 * (COS_1 + r2 * (COS_2 + r2 * COS_3));
+	switch (j & 3)
+	{
+	case 0: s = sinR; c = cosR; break;
+	case 1: s = cosR; c = -sinR; break;
+	case 2: s = -sinR; c = -cosR; break;
+	default: s = -cosR; c = sinR; break;
+	}
+}
+
+static float wrapPhase(float phase)
+{
+	return phase - TWO_PI * std::floor(phase * INV_TWO_PI + 0.5f);
+}
+
+#ifdef TENTACLES_SSE2
+// Same reduction and polynomials as fastSinCos, four lanes at once
+static void fastSinCos4(__m128 x, __m128& s, __m128& c)
+{
+	__m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+	__m128 fj = _mm_cvtepi32_ps(j);
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(fj, _mm_set1_ps(HALF_PI_1)));
+	r = _mm_sub_ps(r, _mm_mul_ps(fj, _mm_set1_ps(HALF_PI_2)));
+	r = _mm_sub_ps(r, _mm_mul_ps(fj, _mm_set1_ps(HALF_PI_3)));
+	__m128 r2 = _mm_mul_ps(r, r);
+
+	__m128 sinPoly = _mm_add_ps(_mm_set1_ps(SIN_2), _mm_mul_ps(r2, _mm_set1_ps(SIN_3)));
+	sinPoly = _mm_add_ps(_mm_set1_ps(SIN_1), _mm_mul_ps(r2, sinPoly));
+	__m128 sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sinPoly));
+	__m128 cosPoly = _mm_add_ps(_mm_set1_ps(COS_2), _mm_mul_ps(r2, _mm_set1_ps(COS_3)));
+	cosPoly = _mm_add_ps(_mm_set1_ps(COS_1), _mm_mul_ps(r2, cosPoly));
+	__m128 cosR = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cosPoly));
+
+	// Odd quadrants swap sin and cos, the quadrant's bit 1 sets the signs
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), 30));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+	s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cosR), _mm_andnot_ps(swap, sinR)), sinSign);
+	c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sinR), _mm_andnot_ps(swap, cosR)), cosSign);
+}
+
+static __m128 wrapPhase4(__m128 phase)
+{
+	__m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(phase, _mm_set1_ps(INV_TWO_PI))));
+	return _mm_sub_ps(phase, _mm_mul_ps(turns, _mm_set1_ps(TWO_PI)));
+}
+#endif
+
+// Phases, tip and both control points for tentacles [begin, end)
+static void updateControlPoints(TentacleSystem& s, size_t begin, size_t end, float dt)
+{
+	size_t i = begin;
+#ifdef TENTACLES_SSE2
+	const __m128 dt4 = _mm_set1_ps(dt);
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 sidePhase = wrapPhase4(_mm_add_ps(_mm_loadu_ps(&s.sidePhase[i]), _mm_mul_ps(_mm_loadu_ps(&s.sideSpeed[i]), dt4)));
+		__m128 controlPhase = wrapPhase4(_mm_add_ps(_mm_loadu_ps(&s.controlPhase[i]), _mm_mul_ps(_mm_loadu_ps(&s.controlSpeed[i]), dt4)));
+		_mm_storeu_ps(&s.sidePhase[i], sidePhase);
+		_mm_storeu_ps(&s.controlPhase[i], controlPhase);
+		__m128 sideSin, sideCos, controlSin, controlCos;
+		fastSinCos4(sidePhase, sideSin, sideCos);
+		fastSinCos4(controlPhase, controlSin, controlCos);
+
+		__m128 aX = _mm_loadu_ps(&s.aX[i]);
+		__m128 aY = _mm_loadu_ps(&s.aY[i]);
+		__m128 tipY = _mm_add_ps(_mm_loadu_ps(&s.bY[i]), _mm_mul_ps(_mm_loadu_ps(&s.sideAmplitude[i]), sideSin));
+		_mm_storeu_ps(&s.tipY[i], tipY);
+
+		__m128 abX = _mm_sub_ps(_mm_loadu_ps(&s.bX[i]), aX);
+		__m128 abY = _mm_sub_ps(tipY, aY);
+		__m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(abX, abX), _mm_mul_ps(abY, abY))));
+		__m128 offset = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&s.controlAmplitude[i]), controlCos), invLength);
+		__m128 offsetX = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), abY), offset);
+		__m128 offsetY = _mm_mul_ps(abX, offset);
+
+		__m128 ratio1 = _mm_loadu_ps(&s.ratio1[i]);
+		__m128 ratio2 = _mm_loadu_ps(&s.ratio2[i]);
+		_mm_storeu_ps(&s.control1X[i], _mm_add_ps(_mm_add_ps(aX, _mm_mul_ps(abX, ratio1)), offsetX));
+		_mm_storeu_ps(&s.control1Y[i], _mm_add_ps(_mm_add_ps(aY, _mm_mul_ps(abY, ratio1)), offsetY));
+		_mm_storeu_ps(&s.control2X[i], _mm_sub_ps(_mm_add_ps(aX, _mm_mul_ps(abX, ratio2)), offsetX));
+		_mm_storeu_ps(&s.control2Y[i], _mm_sub_ps(_mm_add_ps(aY, _mm_mul_ps(abY, ratio2)), offsetY));
+	}
+#endif
+	for (; i < end; ++i)
+	{
+		s.sidePhase[i] = wrapPhase(s.sidePhase[i] + s.sideSpeed[i] * dt);
+		s.controlPhase[i] = wrapPhase(s.controlPhase[i] + s.controlSpeed[i] * dt);
+		float sideSin, sideCos, controlSin, controlCos;
+		fastSinCos(s.sidePhase[i], sideSin, sideCos);
+		fastSinCos(s.controlPhase[i], controlSin, controlCos);
+
+		s.tipY[i] = s.bY[i] + s.sideAmplitude[i] * sideSin;
+		float abX = s.bX[i] - s.aX[i];
+		float abY = s.tipY[i] - s.aY[i];
+		float offset = s.controlAmplitude[i] * controlCos / std::sqrt(abX * abX + abY * abY);
+		float offsetX = -abY * offset;
+		float offsetY = abX * offset;
+		s.control1X[i] = s.aX[i] + abX * s.ratio1[i] + offsetX;
+		s.control1Y[i] = s.aY[i] + abY * s.ratio1[i] + offsetY;
+		s.control2X[i] = s.aX[i] + abX * s.ratio2[i] - offsetX;
+		s.control2Y[i] = s.aY[i] + abY * s.ratio2[i] - offsetY;
+	}
+}
+
+TentacleSystem::TentacleSystem(const std::string& name)
+	:name(name)
+	, shaderName(LINE_SHADER_NAME)
+	, blendMode(BlendMode::Alpha)
+	, numSteps(0)
+	, bounds()
+	, vaoID(0), positionVboID(0), colourVboID(0), eboID(0)
+	, bufferedTentacles(0), shaderVariant()
+{}
+
+void initTentacleSystem(TentacleSystem& system, int numSteps)
+{
+	system.numSteps = std::max(numSteps, 1);
+	int numPoints = system.numSteps + 1;
+	system.bezierWeights.resize(numPoints);
+	system.widthScale.resize(numPoints);
+	for (int i = 0; i < numPoints; ++i)
+	{
+		float t = i / (float)system.numSteps;
+		float u = 1.0f - t;
+		system.bezierWeights[i] = glm::vec4(u * u * u, 3.0f * u * u * t, 3.0f * u * t * t, t * t * t);
+		system.widthScale[i] = 1.0f - i / (float)numPoints;
+	}
+}
+
+size_t addTentacle(TentacleSystem& system, const TentacleParams& params)
+{
+	system.aX.push_back(params.a.x);
+	system.aY.push_back(params.a.y);
+	system.bX.push_back(params.b.x);
+	system.bY.push_back(params.b.y);
+	system.controlSpeed.push_back(params.controlSpeed);
+	system.sideSpeed.push_back(params.sideSpeed);
+	system.controlAmplitude.push_back(params.controlAmplitude);
+	system.sideAmplitude.push_back(params.sideAmplitude);
+	system.ratio1.push_back(params.ratio1);
+	system.ratio2.push_back(params.ratio2);
+	system.width.push_back(params.width);
+	system.colour.push_back(params.colour);
+	system.controlPhase.push_back(wrapPhase(params.controlSpeed * params.startTime));
+	system.sidePhase.push_back(wrapPhase(params.sideSpeed * params.startTime));
+
+	size_t count = system.aX.size();
+	system.tipY.resize(count);
+	system.control1X.resize(count);
+	system.control1Y.resize(count);
+	system.control2X.resize(count);
+	system.control2Y.resize(count);
+	system.vertices.resize(count * getTentacleVertexCount(system) * 2);
+
+	// Start at rest so the first frames have two steps to blend
+	updateControlPoints(system, count - 1, count, 0.0f);
+	system.prevTipY.push_back(system.tipY.back());
+	system.prevControl1X.push_back(system.control1X.back());
+	system.prevControl1Y.push_back(system.control1Y.back());
+	system.prevControl2X.push_back(system.control2X.back());
+	system.prevControl2Y.push_back(system.control2Y.back());
+	return count - 1;
+}
+
+// The latest step becomes the previous one
+static void savePreviousStep(TentacleSystem& s, size_t begin, size_t end)
+{
+	std::copy(s.tipY.begin() + begin, s.tipY.begin() + end, s.prevTipY.begin() + begin);
+	std::copy(s.control1X.begin() + begin, s.control1X.begin() + end, s.prevControl1X.begin() + begin);
+	std::copy(s.control1Y.begin() + begin, s.control1Y.begin() + end, s.prevControl1Y.begin() + begin);
+	std::copy(s.control2X.begin() + begin, s.control2X.begin() + end, s.prevControl2X.begin() + begin);
+	std::copy(s.control2Y.begin() + begin, s.control2Y.begin() + end, s.prevControl2Y.begin() + begin);
+}
+
+static glm::vec2 curvePoint(const glm::vec4& w, const glm::vec2& a, const glm::vec2& c1, const glm::vec2& c2, const glm::vec2& b)
+{
+	return a * w.x + c1 * w.y + c2 * w.z + b * w.w;
+}
+
+static glm::vec2 unitNormal(const glm::vec2& d)
+{
+	return glm::vec2(-d.y, d.x) / std::sqrt(d.x * d.x + d.y * d.y);
+}
+
+// Same mitred strip as setPoints, written in place, and the range's bounds
+static void buildStrips(TentacleSystem& s, size_t begin, size_t end, float alpha, Bounds2D& rangeBounds)
+{
+	const int numPoints = s.numSteps + 1;
+	const size_t floatsPerTentacle = getTentacleVertexCount(s) * 2;
+	const glm::vec4* weights = s.bezierWeights.data();
+	for (size_t i = begin; i < end; ++i)
+	{
+		glm::vec2 a(s.aX[i], s.aY[i]);
+		glm::vec2 b(s.bX[i], s.prevTipY[i] + (s.tipY[i] - s.prevTipY[i]) * alpha);
+		glm::vec2 c1 = glm::mix(glm::vec2(s.prevControl1X[i], s.prevControl1Y[i]), glm::vec2(s.control1X[i], s.control1Y[i]), alpha);
+		glm::vec2 c2 = glm::mix(glm::vec2(s.prevControl2X[i], s.prevControl2Y[i]), glm::vec2(s.control2X[i], s.control2Y[i]), alpha);
+		GLfloat* out = &s.vertices[i * floatsPerTentacle];
+
+		// The curve stays inside its control points
+		glm::vec2 minPos = glm::min(glm::min(a, b), glm::min(c1, c2)) - s.width[i];
+		glm::vec2 maxPos = glm::max(glm::max(a, b), glm::max(c1, c2)) + s.width[i];
+		rangeBounds.minPos = glm::min(rangeBounds.minPos, minPos);
+		rangeBounds.maxPos = glm::max(rangeBounds.maxPos, maxPos);
+
+		glm::vec2 prev = curvePoint(weights[0], a, c1, c2, b);
+		glm::vec2 current = curvePoint(weights[1], a, c1, c2, b);
+		glm::vec2 normal = unitNormal(current - prev);
+		float pointWidth = s.width[i] * s.widthScale[0];
+		out[0] = prev.x + pointWidth * normal.x;
+		out[1] = prev.y + pointWidth * normal.y;
+		out[2] = prev.x - pointWidth * normal.x;
+		out[3] = prev.y - pointWidth * normal.y;
+		for (int j = 1; j < numPoints; ++j)
+		{
+			glm::vec2 offset;
+			pointWidth = s.width[i] * s.widthScale[j];
+			glm::vec2 next = current;
+			if (j == numPoints - 1)
+			{
+				offset = unitNormal(current - prev) * pointWidth;
+			}
+			else
+			{
+				next = curvePoint(weights[j + 1], a, c1, c2, b);
+				glm::vec2 ab = glm::normalize(current - prev);
+				glm::vec2 bc = glm::normalize(next - current);
+				glm::vec2 tangent = glm::normalize(ab + bc);
+				glm::vec2 miter(-tangent.y, tangent.x);
+				offset = miter * (pointWidth / glm::dot(miter, glm::vec2(-bc.y, bc.x)));
+			}
+			out += 4;
+			out[0] = current.x + offset.x;
+			out[1] = current.y + offset.y;
+			out[2] = current.x - offset.x;
+			out[3] = current.y - offset.y;
+			prev = current;
+			current = next;
+		}
+	}
+}
+
+void stepTentacles(TentacleSystem& system, float dt)
+{
+	parallelFor(getTentacleCount(system), TENTACLES_PER_JOB, [&system, dt](size_t begin, size_t end)
+	{
+		savePreviousStep(system, begin, end);
+		updateControlPoints(system, begin, end, dt);
+	});
+}
+
+void buildTentacleGeometry(TentacleSystem& system, float alpha)
+{
+	system.bounds.minPos = glm::vec2(FLT_MAX);
+	system.bounds.maxPos = glm::vec2(-FLT_MAX);
+	std::mutex boundsMutex;
+	parallelFor(getTentacleCount(system), TENTACLES_PER_JOB, [&system, &boundsMutex, alpha](size_t begin, size_t end)
+	{
+		Bounds2D rangeBounds;
+		rangeBounds.minPos = glm::vec2(FLT_MAX);
+		rangeBounds.maxPos = glm::vec2(-FLT_MAX);
+		buildStrips(system, begin, end, alpha, rangeBounds);
+
+		std::lock_guard<std::mutex> lock(boundsMutex);
+		system.bounds.minPos = glm::min(system.bounds.minPos, rangeBounds.minPos);
+		system.bounds.maxPos = glm::max(system.bounds.maxPos, rangeBounds.maxPos);
+	});
+}
+
+void updateTentacles(TentacleSystem& system, float dt)
+{
+	stepTentacles(system, dt);
+	buildTentacleGeometry(system, 1.0f);
+}
+
+bool buildTentacleBuffers(TentacleSystem& system)
+{
+	const size_t count = getTentacleCount(system);
+	const size_t verticesPer = getTentacleVertexCount(system);
+	const int numPoints = system.numSteps + 1;
+	if (system.vaoID == 0)
+	{
+		glCreateVertexArrays(1, &system.vaoID);
+		glCreateBuffers(1, &system.positionVboID);
+		glCreateBuffers(1, &system.colourVboID);
+		glCreateBuffers(1, &system.eboID);
+		if (system.vaoID == 0 || system.positionVboID == 0 || system.colourVboID == 0 || system.eboID == 0)
+		{
+			logError("TentacleSystem:: buffer creation failed");
+			return false;
+		}
+		glVertexArrayVertexBuffer(system.vaoID, 0, system.positionVboID, 0, 2 * sizeof(GLfloat));
+		glVertexArrayAttribFormat(system.vaoID, TENTACLE_ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(system.vaoID, TENTACLE_ATTR_POS, 0);
+		glEnableVertexArrayAttrib(system.vaoID, TENTACLE_ATTR_POS);
+		glVertexArrayVertexBuffer(system.vaoID, 1, system.colourVboID, 0, 4 * sizeof(GLubyte));
+		glVertexArrayAttribFormat(system.vaoID, TENTACLE_ATTR_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0);
+		glVertexArrayAttribBinding(system.vaoID, TENTACLE_ATTR_COLOUR, 1);
+		glEnableVertexArrayAttrib(system.vaoID, TENTACLE_ATTR_COLOUR);
+		glVertexArrayElementBuffer(system.vaoID, system.eboID);
+	}
+
+	// Colours fade from root to tip and never change, both vertices of a point share one
+	std::vector<GLubyte> colours(count * verticesPer * 4);
+	float fadeStep = 1.0f / numPoints;
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t rgba = system.colour[i];
+		for (int j = 0; j < numPoints; ++j)
+		{
+			float fade = 1.0f - fadeStep * j;
+			GLubyte colour[4] = {
+				(GLubyte)(((rgba >> 24) & 0xff) * fade),
+				(GLubyte)((rgba >> 16) & 0xff),
+				(GLubyte)((rgba >> 8) & 0xff),
+				(GLubyte)((rgba & 0xff) * fade) };
+			GLubyte* out = &colours[((i * numPoints + j) * 2) * 4];
+			std::copy(colour, colour + 4, out);
+			std::copy(colour, colour + 4, out + 4);
+		}
+	}
+
+	// The +/- pairs already alternate like a strip wants, a restart index separates tentacles
+	std::vector<GLuint> indexes;
+	indexes.reserve(count * (verticesPer + 1));
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (size_t v = 0; v < verticesPer; ++v)
+		{
+			indexes.push_back((GLuint)(i * verticesPer + v));
+		}
+		indexes.push_back(TENTACLE_RESTART_INDEX);
+	}
+
+	glNamedBufferData(system.positionVboID, system.vertices.size() * sizeof(GLfloat), system.vertices.data(), GL_STREAM_DRAW);
+	glNamedBufferData(system.colourVboID, colours.size(), colours.data(), GL_STATIC_DRAW);
+	glNamedBufferData(system.eboID, indexes.size() * sizeof(GLuint), indexes.data(), GL_STATIC_DRAW);
+	system.bufferedTentacles = count;
+	return true;
+}
+
+static void drawTentacles(TentacleSystem& system, const void* vertices)
+{
+	if (system.bufferedTentacles == 0) return;
+
+	Shader* shader = getShaderVariant(system.shaderName, SHADER_VERTEX_COLOUR, system.shaderVariant);
+	if (shader == nullptr)
+	{
+		logError("Shader not found!!");
+		return;
+	}
+	const size_t verticesPer = getTentacleVertexCount(system);
+	glNamedBufferSubData(system.positionVboID, 0, system.bufferedTentacles * verticesPer * 2 * sizeof(GLfloat), vertices);
+
+	shader->useProgram();
+	shader->registerUniform1f("additive", additiveFactor(system.blendMode));
+	applyBlendMode(system.blendMode);
+
+	// Vertices are already in world space: draw data entry 0, the identity
+	glBindVertexArray(system.vaoID);
+	setDefaultDrawID();
+	glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+	glDrawElements(GL_TRIANGLE_STRIP, (GLsizei)(system.bufferedTentacles * (verticesPer + 1)), GL_UNSIGNED_INT, nullptr);
+	glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+}
+
+void TentacleSystem::draw(SDL_Window* w, Camera* c)
+{
+	drawTentacles(*this, vertices.data());
+}
+
+bool TentacleSystem::recordDraw(FramePacket& packet, PacketDraw& draw)
+{
+	if (bufferedTentacles == 0) return false;
+
+	draw.dataSize = (uint32_t)(bufferedTentacles * getTentacleVertexCount(*this) * 2 * sizeof(GLfloat));
+	draw.dataOffset = appendPacketData(packet, vertices.data(), draw.dataSize);
+	return true;
+}
+
+void TentacleSystem::drawRecorded(SDL_Window* w, Camera* c, const FramePacket& packet, const PacketDraw& draw)
+{
+	drawTentacles(*this, getPacketData(packet, draw));
+}
+
+void TentacleSystem::cleanup()
+{
+	glDeleteBuffers(1, &positionVboID);
+	glDeleteBuffers(1, &colourVboID);
+	glDeleteBuffers(1, &eboID);
+	glDeleteVertexArrays(1, &vaoID);
+	positionVboID = colourVboID = eboID = vaoID = 0;
+	bufferedTentacles = 0;
+}
+
+DrawSortInfo TentacleSystem::getSortInfo() const
+{
+	return DrawSortInfo{ layer, blendMode != BlendMode::Opaque, getShaderVariantID(shaderName, SHADER_VERTEX_COLOUR, shaderVariant), 0, 0.0f };
+}
+
+bool TentacleSystem::getBounds(Bounds2D& bounds) const
+{
+	if (bufferedTentacles == 0 || this->bounds.minPos.x > this->bounds.maxPos.x) return false;
+
+	bounds = this->bounds;
+	return true;
+}
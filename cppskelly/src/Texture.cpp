@@ -3,26 +3,237 @@
 #include <SDL_surface.h>
 #include <SDL_image.h>
 #include <sstream>
+#include <future>
 
-TTextureTable gTextures;
+TextureRegistry gTextures;
 
+// Decodes started by prefetchTextures, by path
+static std::map<std::string, std::future<SDL_Surface*>> gPendingDecodes;
 
-bool loadTexture(const std::string& fileName, GLuint& texture, GLuint& width, GLuint& height, TTextureTable& table)
+void prefetchTextures(const std::vector<std::string>& fileNames)
 {
-	TTextureTableIter value = table.find(fileName);
-	if (value != table.end())
+	for (const std::string& fileName : fileNames)
+	{
+		if (gPendingDecodes.count(fileName) > 0) continue;
+		gPendingDecodes[fileName] = std::async(std::launch::async, [fileName]() { return IMG_Load(fileName.c_str()); });
+	}
+}
+
+// The prefetched surface if there is one (waiting for it if need be), else a fresh decode
+static SDL_Surface* decodeImage(const std::string& fileName)
+{
+	std::map<std::string, std::future<SDL_Surface*>>::iterator it = gPendingDecodes.find(fileName);
+	if (it == gPendingDecodes.end())
+	{
+		return IMG_Load(fileName.c_str());
+	}
+	SDL_Surface* surface = it->second.get();
+	gPendingDecodes.erase(it);
+	return surface != nullptr ? surface : IMG_Load(fileName.c_str());
+}
+
+static const uint64_t CONTENT_HASH_SEED = 14695981039346656037ULL; // The standard FNV offset basis
+static const uint64_t CONTENT_CHECK_SEED = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint64_t FNV_PRIME = 1099511628211ULL;
+
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+// FNV-1a over the format, the palette and the visible pixels (row by row, so
+// pitch padding is ignored). Indexed images that differ only in their palette
+// must not share a slot.
+static uint64_t hashSurfaceContents(SDL_Surface* surface, uint64_t seed)
+{
+	const SDL_PixelFormat* format = surface->format;
+	Uint32 colourKey = 0;
+	const bool hasColourKey = SDL_GetColorKey(surface, &colourKey) == 0;
+	const uint32_t header[9] = { (uint32_t)surface->w, (uint32_t)surface->h, format->format, format->BytesPerPixel,
+		format->Rmask, format->Gmask, format->Bmask, format->Amask, hasColourKey ? colourKey : 0xffffffff };
+	uint64_t hash = hashBytes(seed, header, sizeof(header));
+
+	if (format->palette != nullptr)
+	{
+		hash = hashBytes(hash, &format->palette->ncolors, sizeof(format->palette->ncolors));
+		hash = hashBytes(hash, format->palette->colors, (size_t)format->palette->ncolors * sizeof(SDL_Color));
+	}
+
+	const size_t rowBytes = (size_t)surface->w * format->BytesPerPixel;
+	for (int y = 0; y < surface->h; ++y)
+	{
+		hash = hashBytes(hash, (const unsigned char*)surface->pixels + (size_t)y * surface->pitch, rowBytes);
+	}
+	return hash;
+}
+
+static inline Uint8 premultiply(Uint32 channel, Uint32 alpha)
+{
+	return (Uint8)((channel * alpha + 127) / 255);
+}
+
+// Scales colour by alpha in place so the whole pipeline can blend with
+// GL_ONE, GL_ONE_MINUS_SRC_ALPHA (see RenderState.h)
+static void premultiplySurface(SDL_Surface* surface)
+{
+	const SDL_PixelFormat* format = surface->format;
+	if (format->BytesPerPixel != 4 || format->Amask == 0)
+	{
+		return;
+	}
+
+	int alphaShift = 0;
+	while (((format->Amask >> alphaShift) & 1) == 0)
+	{
+		++alphaShift;
+	}
+
+	if (SDL_MUSTLOCK(surface))
+	{
+		SDL_LockSurface(surface);
+	}
+	for (int y = 0; y < surface->h; ++y)
+	{
+		Uint32* row = (Uint32*)((Uint8*)surface->pixels + (size_t)y * surface->pitch);
+		for (int x = 0; x < surface->w; ++x)
+		{
+			Uint32 pixel = row[x];
+			Uint32 alpha = (pixel & format->Amask) >> alphaShift;
+			if (alpha == 0xff)
+			{
+				continue;
+			}
+
+			Uint32 result = pixel & format->Amask;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				if (shift == alphaShift)
+				{
+					continue;
+				}
+				result |= (Uint32)premultiply((pixel >> shift) & 0xff, alpha) << shift;
+			}
+			row[x] = result;
+		}
+	}
+	if (SDL_MUSTLOCK(surface))
+	{
+		SDL_UnlockSurface(surface);
+	}
+}
+
+static GLuint createPaletteTexture(const unsigned char* straightRGBA)
+{
+	unsigned char coloursRGBA[PALETTE_SIZE * 4];
+	for (int i = 0; i < PALETTE_SIZE; ++i)
+	{
+		Uint32 alpha = straightRGBA[i * 4 + 3];
+		coloursRGBA[i * 4] = premultiply(straightRGBA[i * 4], alpha);
+		coloursRGBA[i * 4 + 1] = premultiply(straightRGBA[i * 4 + 1], alpha);
+		coloursRGBA[i * 4 + 2] = premultiply(straightRGBA[i * 4 + 2], alpha);
+		coloursRGBA[i * 4 + 3] = (unsigned char)alpha;
+	}
+
+	GLuint palette;
+	glCreateTextures(GL_TEXTURE_2D, 1, &palette);
+	glTextureStorage2D(palette, 1, GL_RGBA8, PALETTE_SIZE, 1);
+	glTextureParameteri(palette, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(palette, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureSubImage2D(palette, 0, 0, 0, PALETTE_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, coloursRGBA);
+	return palette;
+}
+
+// Indexes go up as-is into a single channel texture; the shader resolves
+// the colour through the palette texture.
+static bool uploadPalettedSurface(SDL_Surface* surface, GLuint& texture, GLuint& palette)
+{
+	SDL_Palette* sdlPalette = surface->format->palette;
+	if (sdlPalette == nullptr)
+	{
+		return false;
+	}
+
+	unsigned char colours[PALETTE_SIZE * 4] = { 0 };
+	for (int i = 0; i < sdlPalette->ncolors && i < PALETTE_SIZE; ++i)
+	{
+		colours[i * 4] = sdlPalette->colors[i].r;
+		colours[i * 4 + 1] = sdlPalette->colors[i].g;
+		colours[i * 4 + 2] = sdlPalette->colors[i].b;
+		colours[i * 4 + 3] = sdlPalette->colors[i].a;
+	}
+
+	// PNG transparency may come through as a colour key instead of palette alpha
+	Uint32 colourKey;
+	if (SDL_GetColorKey(surface, &colourKey) == 0 && colourKey < PALETTE_SIZE)
+	{
+		colours[colourKey * 4 + 3] = 0;
+	}
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, GL_R8, surface->w, surface->h);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, surface->pitch);
+	glTextureSubImage2D(texture, 0, 0, 0, surface->w, surface->h, GL_RED, GL_UNSIGNED_BYTE, surface->pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	palette = createPaletteTexture(colours);
+	return true;
+}
+
+static TextureHandle allocateSlot(TextureRegistry& registry)
+{
+	uint32_t index;
+	if (!registry.freeSlots.empty())
+	{
+		index = registry.freeSlots.back();
+		registry.freeSlots.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)registry.textures.size();
+		registry.textures.push_back(Texture());
+		registry.generations.push_back(0);
+		registry.refCounts.push_back(0);
+	}
+	registry.refCounts[index] = 1;
+	return TextureHandle(index, registry.generations[index]);
+}
+
+TextureHandle findTexture(const std::string& fileName, const TextureRegistry& registry)
+{
+	std::map<std::string, TextureHandle>::const_iterator it = registry.pathLookup.find(fileName);
+	if (it != registry.pathLookup.end() && isValid(it->second, registry))
+	{
+		return it->second;
+	}
+	return TextureHandle();
+}
+
+bool loadTexture(const std::string& fileName, TextureHandle& handle, TextureRegistry& registry)
+{
+	handle = findTexture(fileName, registry);
+	if (isValid(handle, registry))
 	{
 		logInfo("Texture was already loaded!");
-		width = value->second.width;
-		height = value->second.height;
-		texture = value->second.texID;
+		registry.refCounts[handle.index]++;
 		return true;
 	}
 
-	SDL_Surface *surface = IMG_Load(fileName.c_str()); // this surface will tell us the details of the image
+	SDL_Surface *surface = decodeImage(fileName); // this surface will tell us the details of the image
 
 	GLint nColors;
-	GLenum textureFormat;
+	GLenum textureFormat = GL_RGBA;
+	bool paletted = false;
+	GLuint palette = 0;
 
 	if (surface)
 	{
@@ -38,6 +249,34 @@ bool loadTexture(const std::string& fileName, GLuint& texture, GLuint& width, GL
 			logInfo("Warning: image.bmps height is not a power of 2");
 		}
 
+		// Same pixels under a different name: alias the existing slot. A match
+		// on the lookup hash is confirmed with a second, differently seeded one.
+		uint64_t contentHash = hashSurfaceContents(surface, CONTENT_HASH_SEED);
+		uint64_t contentCheck = hashSurfaceContents(surface, CONTENT_CHECK_SEED);
+		bool ownsContentHash = true;
+		std::map<uint64_t, TextureHandle>::iterator dupIt = registry.contentLookup.find(contentHash);
+		if (dupIt != registry.contentLookup.end() && isValid(dupIt->second, registry))
+		{
+			const Texture& existing = registry.textures[dupIt->second.index];
+			if (existing.contentCheck == contentCheck && existing.width == (unsigned int)surface->w && existing.height == (unsigned int)surface->h)
+			{
+				std::ostringstream sstream;
+				sstream << "LoadTexture:: " << fileName.c_str() << " has the same contents as " << existing.path.c_str() << ", sharing it";
+				logInfo(sstream.str().c_str());
+
+				handle = dupIt->second;
+				registry.refCounts[handle.index]++;
+				registry.pathLookup[fileName] = handle;
+				SDL_FreeSurface(surface);
+				return true;
+			}
+
+			std::ostringstream sstream;
+			sstream << "LoadTexture:: " << fileName.c_str() << " collides with " << existing.path.c_str() << " on the content hash, loading it separately";
+			logInfo(sstream.str().c_str());
+			ownsContentHash = false;
+		}
+
 		//get number of channels in the SDL surface
 		nColors = surface->format->BytesPerPixel;
 
@@ -56,29 +295,52 @@ bool loadTexture(const std::string& fileName, GLuint& texture, GLuint& width, GL
 			else
 				textureFormat = GL_BGR;
 		}
+		else if (nColors == 1 && surface->format->palette != nullptr)
+		{
+			paletted = true;
+			textureFormat = GL_RED;
+		}
 		else
 		{
 			logInfo("warning: the image is not truecolor...this will break ");
 		}
 
+		GLuint texture;
+		if (paletted)
+		{
+			uploadPalettedSurface(surface, texture, palette);
+		}
+		else
+		{
+			premultiplySurface(surface);
+			glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+			glTextureStorage2D(texture, 1, GL_RGBA8, surface->w, surface->h);
+			glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTextureSubImage2D(texture, 0, 0, 0, surface->w, surface->h, textureFormat, GL_UNSIGNED_BYTE, surface->pixels);
+		}
 
-		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
-		glTextureStorage2D(texture, 1, GL_RGBA8, surface->w, surface->h);
-		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTextureSubImage2D(texture, 0, 0, 0, surface->w, surface->h, textureFormat, GL_UNSIGNED_BYTE, surface->pixels);
-
-		width = surface->w;
-		height = surface->h;
-
-		Texture t;
+		handle = allocateSlot(registry);
+		Texture& t = registry.textures[handle.index];
 		t.path = fileName;
 		t.width = surface->w;
 		t.height = surface->h;
 		t.bpp = nColors;
 		t.texID = texture;
 		t.texFormat = textureFormat;
-		table[t.path] = t;
+		t.contentHash = contentHash;
+		t.contentCheck = contentCheck;
+		t.paletted = paletted;
+		t.paletteIDs.clear();
+		if (paletted)
+		{
+			t.paletteIDs.push_back(palette);
+		}
+		registry.pathLookup[fileName] = handle;
+		if (ownsContentHash)
+		{
+			registry.contentLookup[contentHash] = handle;
+		}
 	}
 	else
 	{
@@ -97,7 +359,112 @@ bool loadTexture(const std::string& fileName, GLuint& texture, GLuint& width, GL
 	return true;
 }
 
+void releaseTexture(TextureHandle handle, TextureRegistry& registry)
+{
+	if (!isValid(handle, registry)) return;
+
+	if (--registry.refCounts[handle.index] > 0) return;
+
+	Texture& t = registry.textures[handle.index];
+	t.cleanUp();
+
+	// Drop every alias pointing to this slot
+	for (std::map<std::string, TextureHandle>::iterator it = registry.pathLookup.begin(); it != registry.pathLookup.end();)
+	{
+		if (it->second == handle)
+			it = registry.pathLookup.erase(it);
+		else
+			++it;
+	}
+	// A texture that collided with another never owned the lookup entry
+	std::map<uint64_t, TextureHandle>::iterator contentIt = registry.contentLookup.find(t.contentHash);
+	if (contentIt != registry.contentLookup.end() && contentIt->second == handle)
+	{
+		registry.contentLookup.erase(contentIt);
+	}
+
+	t = Texture();
+	registry.generations[handle.index]++;
+	registry.freeSlots.push_back(handle.index);
+}
+
+int addPaletteVariant(TextureHandle handle, const std::vector<uint32_t>& coloursRGBA, TextureRegistry& registry)
+{
+	if (!isValid(handle, registry) || !registry.textures[handle.index].paletted)
+	{
+		logError("addPaletteVariant:: not a paletted texture");
+		return -1;
+	}
+
+	// 0xRRGGBBAA, same packing the tentacles use for their colours
+	unsigned char colours[PALETTE_SIZE * 4] = { 0 };
+	for (size_t i = 0; i < coloursRGBA.size() && i < (size_t)PALETTE_SIZE; ++i)
+	{
+		colours[i * 4] = (coloursRGBA[i] >> 24) & 0xff;
+		colours[i * 4 + 1] = (coloursRGBA[i] >> 16) & 0xff;
+		colours[i * 4 + 2] = (coloursRGBA[i] >> 8) & 0xff;
+		colours[i * 4 + 3] = coloursRGBA[i] & 0xff;
+	}
+
+	Texture& t = registry.textures[handle.index];
+	t.paletteIDs.push_back(createPaletteTexture(colours));
+	return (int)t.paletteIDs.size() - 1;
+}
+
+SDL_Surface* loadSurfaceRGBA(const std::string& fileName)
+{
+	SDL_Surface* loaded = decodeImage(fileName);
+	if (loaded == nullptr)
+	{
+		std::ostringstream sstream;
+		sstream << "loadSurfaceRGBA:: Could not load " << fileName.c_str() << ": " << SDL_GetError();
+		logError(sstream.str().c_str());
+		return nullptr;
+	}
+
+	// ABGR8888 is R,G,B,A in memory on little endian (SDL_PIXELFORMAT_RGBA32 needs 2.0.5)
+	SDL_Surface* converted = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ABGR8888, 0);
+	SDL_FreeSurface(loaded);
+	if (converted == nullptr)
+	{
+		logError("loadSurfaceRGBA:: conversion failed");
+		return nullptr;
+	}
+	premultiplySurface(converted);
+	return converted;
+}
+
+void cleanupTextures(TextureRegistry& registry)
+{
+	// Decodes nobody picked up
+	for (std::map<std::string, std::future<SDL_Surface*>>::iterator it = gPendingDecodes.begin(); it != gPendingDecodes.end(); ++it)
+	{
+		SDL_FreeSurface(it->second.get());
+	}
+	gPendingDecodes.clear();
+
+	for (size_t i = 0; i < registry.textures.size(); ++i)
+	{
+		if (registry.refCounts[i] > 0)
+		{
+			registry.textures[i].cleanUp();
+			registry.refCounts[i] = 0;
+		}
+	}
+	registry.textures.clear();
+	registry.generations.clear();
+	registry.refCounts.clear();
+	registry.freeSlots.clear();
+	registry.pathLookup.clear();
+	registry.contentLookup.clear();
+}
+
 void Texture::cleanUp()
 {
 	glDeleteTextures(1, &texID);
-}
\ No newline at end of file
+	if (!paletteIDs.empty())
+	{
+		glDeleteTextures((GLsizei)paletteIDs.size(), paletteIDs.data());
+		paletteIDs.clear();
+	}
+}
@@ -0,0 +1,325 @@
+#include "Tilemap.h"
+#include "Camera.h"
+#include "FrameData.h"
+#include "Shader.h"
+#include "logUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+
+const int TILEMAP_VBO_ATTR_POS = 0;
+const int TILEMAP_VBO_ATTR_UV = 1;
+
+static const int TILE_VERTICES_PER_QUAD = 4;
+static const int TILE_INDEXES_PER_QUAD = 6;
+
+// Reused by every chunk rebuild so edits don't allocate
+static std::vector<GLfloat> gChunkScratch;
+
+Tilemap::Tilemap(const std::string& name)
+	:name(name)
+	, shaderName()
+	, tileset()
+	, samplerID(0), shaderVariant()
+	, width(0), height(0)
+	, tileSize(1.0f, 1.0f), origin()
+	, chunksX(0), chunksY(0)
+	, eboID(0)
+	, blendMode(BlendMode::Opaque)
+	, visibleChunks(0), rebuiltChunks(0)
+{}
+
+bool initTileset(Tileset& tileset, const std::string& texPath, int tileWidth, int tileHeight)
+{
+	if (!loadTexture(texPath, tileset.texHandle, gTextures))
+	{
+		return false;
+	}
+
+	const Texture* tex = getTexture(tileset.texHandle, gTextures);
+	tileset.texID = tex->texID;
+	tileset.paletteTexID = tex->paletted ? tex->paletteIDs[0] : 0;
+	tileset.texWidth = tex->width;
+	tileset.texHeight = tex->height;
+	tileset.tileWidth = tileWidth;
+	tileset.tileHeight = tileHeight;
+	tileset.columns = tex->width / tileWidth;
+	tileset.rows = tex->height / tileHeight;
+	return true;
+}
+
+bool initTilemap(Tilemap& map, const std::string& texPath, const std::string& shaderName, int width, int height, int sheetTileWidth, int sheetTileHeight, const glm::vec2& tileSize)
+{
+	if (!initTileset(map.tileset, texPath, sheetTileWidth, sheetTileHeight))
+	{
+		logError("Tilemap:: could not load the tilesheet");
+		return false;
+	}
+
+	map.shaderName = shaderName;
+	map.width = width;
+	map.height = height;
+	map.tileSize = tileSize;
+	map.tiles.assign((size_t)width * height, TILE_EMPTY);
+
+	map.chunksX = (width + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+	map.chunksY = (height + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+	map.chunks.assign((size_t)map.chunksX * map.chunksY, TilemapChunk());
+
+	map.eboID = createTileIndexBuffer();
+
+	glCreateSamplers(1, &map.samplerID);
+	glSamplerParameteri(map.samplerID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(map.samplerID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glSamplerParameteri(map.samplerID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(map.samplerID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return true;
+}
+
+void setTile(Tilemap& map, int x, int y, uint16_t tile)
+{
+	if (x < 0 || y < 0 || x >= map.width || y >= map.height) return;
+
+	uint16_t& current = map.tiles[(size_t)y * map.width + x];
+	if (current == tile) return;
+
+	current = tile;
+	map.chunks[(y / TILEMAP_CHUNK_SIZE) * map.chunksX + (x / TILEMAP_CHUNK_SIZE)].dirty = true;
+}
+
+uint16_t getTile(const Tilemap& map, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= map.width || y >= map.height) return TILE_EMPTY;
+	return map.tiles[(size_t)y * map.width + x];
+}
+
+void setTiles(Tilemap& map, const std::vector<uint16_t>& tiles)
+{
+	if (tiles.size() != map.tiles.size())
+	{
+		logError("Tilemap:: tile data doesn't match the map size");
+		return;
+	}
+	map.tiles = tiles;
+	for (TilemapChunk& chunk : map.chunks)
+	{
+		chunk.dirty = true;
+	}
+}
+
+int buildTileQuads(const uint16_t* tiles, int blockWidth, int blockHeight, int rowStride, const glm::vec2& blockOrigin, const glm::vec2& tileSize, const Tileset& tileset, std::vector<GLfloat>& out)
+{
+	const float uStep = tileset.tileWidth / (float)tileset.texWidth;
+	const float vStep = tileset.tileHeight / (float)tileset.texHeight;
+	const int numSheetTiles = tileset.columns * tileset.rows;
+
+	int numQuads = 0;
+	for (int y = 0; y < blockHeight; ++y)
+	{
+		const uint16_t* row = tiles + (size_t)y * rowStride;
+		float y0 = blockOrigin.y + y * tileSize.y;
+		float y1 = y0 + tileSize.y;
+		for (int x = 0; x < blockWidth; ++x)
+		{
+			uint16_t tile = row[x];
+			if (tile == TILE_EMPTY || tile >= numSheetTiles) continue;
+
+			float x0 = blockOrigin.x + x * tileSize.x;
+			float x1 = x0 + tileSize.x;
+			// v = 0 is the top of the sheet
+			float u0 = (tile % tileset.columns) * uStep;
+			float v0 = (tile / tileset.columns) * vStep;
+			float u1 = u0 + uStep;
+			float v1 = v0 + vStep;
+
+			const GLfloat quad[TILE_VERTICES_PER_QUAD * TILEMAP_FLOATS_PER_VERTEX] =
+			{
+				x0, y0, u0, v1,
+				x1, y0, u1, v1,
+				x1, y1, u1, v0,
+				x0, y1, u0, v0
+			};
+			out.insert(out.end(), std::begin(quad), std::end(quad));
+			++numQuads;
+		}
+	}
+	return numQuads;
+}
+
+GLuint createTileIndexBuffer()
+{
+	std::vector<GLushort> indexes(TILEMAP_MAX_QUADS_PER_CHUNK * TILE_INDEXES_PER_QUAD);
+	for (int i = 0; i < TILEMAP_MAX_QUADS_PER_CHUNK; ++i)
+	{
+		GLushort base = (GLushort)(i * TILE_VERTICES_PER_QUAD);
+		GLushort* quad = &indexes[i * TILE_INDEXES_PER_QUAD];
+		quad[0] = base;
+		quad[1] = base + 1;
+		quad[2] = base + 2;
+		quad[3] = base;
+		quad[4] = base + 2;
+		quad[5] = base + 3;
+	}
+
+	GLuint ebo;
+	glCreateBuffers(1, &ebo);
+	glNamedBufferStorage(ebo, indexes.size() * sizeof(GLushort), indexes.data(), 0);
+	return ebo;
+}
+
+void uploadChunk(TilemapChunk& chunk, const std::vector<GLfloat>& vertices, int numQuads, GLuint eboID)
+{
+	if (chunk.vaoID == 0)
+	{
+		glCreateVertexArrays(1, &chunk.vaoID);
+		glCreateBuffers(1, &chunk.vboID);
+
+		const GLsizei stride = TILEMAP_FLOATS_PER_VERTEX * sizeof(GLfloat);
+		glVertexArrayVertexBuffer(chunk.vaoID, 0, chunk.vboID, 0, stride);
+		glVertexArrayElementBuffer(chunk.vaoID, eboID);
+
+		glEnableVertexArrayAttrib(chunk.vaoID, TILEMAP_VBO_ATTR_POS);
+		glVertexArrayAttribFormat(chunk.vaoID, TILEMAP_VBO_ATTR_POS, 2, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(chunk.vaoID, TILEMAP_VBO_ATTR_POS, 0);
+
+		glEnableVertexArrayAttrib(chunk.vaoID, TILEMAP_VBO_ATTR_UV);
+		glVertexArrayAttribFormat(chunk.vaoID, TILEMAP_VBO_ATTR_UV, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat));
+		glVertexArrayAttribBinding(chunk.vaoID, TILEMAP_VBO_ATTR_UV, 0);
+	}
+
+	chunk.numQuads = numQuads;
+	if (numQuads > 0)
+	{
+		glNamedBufferData(chunk.vboID, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+	}
+	chunk.dirty = false;
+}
+
+void drawChunk(const TilemapChunk& chunk)
+{
+	glBindVertexArray(chunk.vaoID);
+	glDrawElements(GL_TRIANGLES, chunk.numQuads * TILE_INDEXES_PER_QUAD, GL_UNSIGNED_SHORT, nullptr);
+}
+
+void cleanupChunk(TilemapChunk& chunk)
+{
+	if (chunk.vaoID == 0) return;
+
+	glDeleteBuffers(1, &chunk.vboID);
+	glDeleteVertexArrays(1, &chunk.vaoID);
+	chunk = TilemapChunk();
+}
+
+static void rebuildChunk(Tilemap& map, int chunkX, int chunkY)
+{
+	int firstX = chunkX * TILEMAP_CHUNK_SIZE;
+	int firstY = chunkY * TILEMAP_CHUNK_SIZE;
+	int blockWidth = std::min(TILEMAP_CHUNK_SIZE, map.width - firstX);
+	int blockHeight = std::min(TILEMAP_CHUNK_SIZE, map.height - firstY);
+	glm::vec2 blockOrigin = map.origin + glm::vec2(firstX * map.tileSize.x, firstY * map.tileSize.y);
+
+	gChunkScratch.clear();
+	const uint16_t* first = &map.tiles[(size_t)firstY * map.width + firstX];
+	int numQuads = buildTileQuads(first, blockWidth, blockHeight, map.width, blockOrigin, map.tileSize, map.tileset, gChunkScratch);
+	uploadChunk(map.chunks[chunkY * map.chunksX + chunkX], gChunkScratch, numQuads, map.eboID);
+}
+
+uint32_t tilemapShaderFeatures(const Tileset& tileset, BlendMode blendMode)
+{
+	uint32_t features = SHADER_TEXTURED;
+	if (tileset.paletteTexID != 0) features |= SHADER_PALETTED;
+	if (blendMode == BlendMode::Opaque) features |= SHADER_ALPHA_TEST;
+	return features;
+}
+
+bool beginTilemapDraw(const std::string& shaderName, ShaderVariantCache& shaderVariant, const Tileset& tileset, unsigned int samplerID, BlendMode blendMode, Camera* c)
+{
+	Shader* shader = getShaderVariant(shaderName, tilemapShaderFeatures(tileset, blendMode), shaderVariant);
+	if (shader == nullptr)
+	{
+		logError("Shader not found!!");
+		return false;
+	}
+
+	// Chunk vertices are already in world space: draw data entry 0, the identity
+
+	const int TEX_UNIT = 0;
+	glBindTextureUnit(TEX_UNIT, tileset.texID);
+	glBindSampler(TEX_UNIT, samplerID);
+
+	shader->registerUniform1i("texture", TEX_UNIT);
+	if (tileset.paletteTexID != 0)
+	{
+		const int PALETTE_UNIT = 1;
+		glBindTextureUnit(PALETTE_UNIT, tileset.paletteTexID);
+		shader->registerUniform1i("palette", PALETTE_UNIT);
+	}
+	shader->registerUniform1f("additive", additiveFactor(blendMode));
+	if (blendMode == BlendMode::Opaque)
+	{
+		shader->registerUniform1f("alphaCutoff", alphaCutoff(blendMode));
+	}
+	shader->useProgram();
+	setDefaultDrawID();
+	applyBlendMode(blendMode);
+	return true;
+}
+
+void Tilemap::draw(SDL_Window* w, Camera* c)
+{
+	visibleChunks = 0;
+	rebuiltChunks = 0;
+
+	glm::vec2 viewMin, viewMax;
+	if (!getViewBounds(c, 0.0f, viewMin, viewMax)) return;
+
+	// Chunk range overlapping the view
+	glm::vec2 chunkExtent = tileSize * (float)TILEMAP_CHUNK_SIZE;
+	int minX = std::max(0, (int)std::floor((viewMin.x - origin.x) / chunkExtent.x));
+	int minY = std::max(0, (int)std::floor((viewMin.y - origin.y) / chunkExtent.y));
+	int maxX = std::min(chunksX - 1, (int)std::floor((viewMax.x - origin.x) / chunkExtent.x));
+	int maxY = std::min(chunksY - 1, (int)std::floor((viewMax.y - origin.y) / chunkExtent.y));
+	if (minX > maxX || minY > maxY) return;
+
+	if (!beginTilemapDraw(shaderName, shaderVariant, tileset, samplerID, blendMode, c)) return;
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		for (int x = minX; x <= maxX; ++x)
+		{
+			TilemapChunk& chunk = chunks[y * chunksX + x];
+			if (chunk.dirty)
+			{
+				rebuildChunk(*this, x, y);
+				++rebuiltChunks;
+			}
+			if (chunk.numQuads == 0) continue;
+
+			drawChunk(chunk);
+			++visibleChunks;
+		}
+	}
+}
+
+void Tilemap::cleanup()
+{
+	for (TilemapChunk& chunk : chunks)
+	{
+		cleanupChunk(chunk);
+	}
+	glDeleteBuffers(1, &eboID);
+	glDeleteSamplers(1, &samplerID);
+	releaseTexture(tileset.texHandle, gTextures);
+}
+
+DrawSortInfo Tilemap::getSortInfo() const
+{
+	return DrawSortInfo{ layer, blendMode != BlendMode::Opaque, getShaderVariantID(shaderName, tilemapShaderFeatures(tileset, blendMode), shaderVariant), tileset.texID, 1.0f };
+}
+
+bool Tilemap::getBounds(Bounds2D& bounds) const
+{
+	bounds.minPos = origin;
+	bounds.maxPos = origin + glm::vec2(width * tileSize.x, height * tileSize.y);
+	return true;
+}
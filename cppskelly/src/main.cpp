@@ -3,6 +3,8 @@
 #include <cstdio>
 #include <sstream>
 #include <chrono>
+#include <cstring>
+#include <fstream>
 
 #define GLM_SWIZZLE 
 #define GLM_FORCE_RADIANS 1
@@ -22,9 +24,28 @@
 #include "logUtils.h"
 #include "Shader.h"
 #include "Camera.h"
+#include "FrameData.h"
 #include "Line.h"
 #include "Sprite.h"
 #include "Texture.h"
+#include "RenderState.h"
+#include "Tilemap.h"
+#include "GpuTilemap.h"
+#include "StreamingTilemap.h"
+#include "Animation.h"
+#include "RenderQueue.h"
+#include "Benchmarks.h"
+#include "GpuStats.h"
+#include "JobSystem.h"
+#include "FramePacket.h"
+#include "RenderThread.h"
+#include "TentacleSystem.h"
+#include "FixedTimestep.h"
+#include "FramePacing.h"
+#include "LateLatch.h"
+#include "LatencyHarness.h"
+#include "Entities.h"
+#include "EntitySystems.h"
 
 static const int SCREEN_FULLSCREEN = 0;
 static const int SCREEN_WIDTH  = 800;
@@ -46,7 +67,7 @@ static void APIENTRY openglCallbackFunction( GLenum source, GLenum type,
   }
 }
 
-bool init(const char * caption, bool fullscreen, int windowWidth, int windowHeight, int x = SDL_WINDOWPOS_CENTERED, int y = SDL_WINDOWPOS_CENTERED) 
+bool init(const char * caption, bool fullscreen, int windowWidth, int windowHeight, int x = SDL_WINDOWPOS_CENTERED, int y = SDL_WINDOWPOS_CENTERED, bool hidden = false) 
 {
   // Initialize SDL 
 	if (SDL_Init(SDL_INIT_VIDEO) < 0)
@@ -76,7 +97,8 @@ bool init(const char * caption, bool fullscreen, int windowWidth, int windowHeig
 	} 
 	else 
 	{
-		window = SDL_CreateWindow(caption, x, y, windowWidth, windowHeight, SDL_WINDOW_OPENGL);
+		// Hidden for headless runs, the context still renders to the back buffer
+		window = SDL_CreateWindow(caption, x, y, windowWidth, windowHeight, SDL_WINDOW_OPENGL | (hidden ? SDL_WINDOW_HIDDEN : 0));
 	}
 
 	if (window == nullptr)
@@ -122,9 +144,6 @@ bool init(const char * caption, bool fullscreen, int windowWidth, int windowHeig
 	glDebugMessageCallback(openglCallbackFunction, nullptr);
 	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, true);
 
-	// Use v-sync
-	SDL_GL_SetSwapInterval(1);
-
 	// Disable depth test and face culling.
 	glDisable(GL_DEPTH_TEST);
 	glDisable(GL_CULL_FACE);
@@ -150,10 +169,7 @@ void close(SDL_Window* window, SDL_GLContext context, std::vector<Drawable*> dra
 		it->second.cleanUp();
 	}
 
-	for (TTextureTableIter it = gTextures.begin(); it != gTextures.end(); ++it)
-	{
-		it->second.cleanUp();
-	}
+	cleanupTextures(gTextures);
 
 
 
@@ -171,58 +187,162 @@ struct Input
 {
 	float xAxis;
 	float yAxis;
+	bool toggleDepthPrepass;
+	uint32_t latencyProbe;
 
 	void reset()
 	{
 		xAxis = yAxis = 0.0f;
+		toggleDepthPrepass = false;
+		latencyProbe = NO_LATENCY_PROBE;
 	}
 };
 
 float switchTimeout;
 bool drawLine;
 
-void update(float dt, Input* input, Sprite* sprite)
+static uint32_t nextRandom(uint32_t& state)
 {
-	sprite->velocity.x = input->xAxis * sprite->speed;
-	sprite->velocity.y = input->yAxis * sprite->speed;
+	// xorshift32
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Walkers head the way their clip faces and now and then turn. Movement
+// itself is updateMovement's job.
+void updateWalkers(EntityWorld& world)
+{
+	const ComponentMask mask = componentBit(COMPONENT_WALKER) | componentBit(COMPONENT_VELOCITY) | componentBit(COMPONENT_ANIMATION);
+	forEachChunk(world, mask, [](EntityChunk& chunk)
+	{
+		const float WALK_SPEED = 40.0f;
+		const glm::vec2 directions[] = { { 0.f, -1.f }, { -1.f, 0.f }, { 1.f, 0.f }, { 0.f, 1.f } };
+		Walker* walker = getChunkComponents<Walker>(chunk);
+		Velocity* velocity = getChunkComponents<Velocity>(chunk);
+		AnimationState* animation = getChunkComponents<AnimationState>(chunk);
+		for (size_t i = 0; i < chunk.count; ++i)
+		{
+			if (nextRandom(walker[i].rng) % 200 == 0)
+			{
+				uint16_t clip = (uint16_t)(nextRandom(walker[i].rng) % 4);
+				if (clip != animation[i].clip)
+				{
+					animation[i].clip = clip;
+					animation[i].time = 0.0f;
+				}
+			}
+			const glm::vec2& dir = directions[animation[i].clip];
+			velocity[i].x = dir.x * WALK_SPEED * walker[i].speed;
+			velocity[i].y = dir.y * WALK_SPEED * walker[i].speed;
+		}
+	});
+}
 
-	sprite->pos.x += sprite->velocity.x * dt;
-	sprite->pos.y += sprite->velocity.y * dt;
+// Position and PreviousPosition both start at pos
+static void placeEntity(EntityWorld& world, EntityID entity, const glm::vec2& pos)
+{
+	Position* position = getComponent<Position>(world, entity);
+	PreviousPosition* previous = getComponent<PreviousPosition>(world, entity);
+	position->x = previous->x = pos.x;
+	position->y = previous->y = pos.y;
 }
 
+static const float CAMERA_SPEED = 600.0f;
+// Furthest the render thread may move the view from where culling saw it
+static const float LATE_LATCH_MAX_SECONDS = 0.05f;
+// Frames between synthetic inputs when measuring latency
+static const int LATENCY_PROBE_INTERVAL = 10;
 
-bool createShader(const std::string& name, const char* files[], GLenum* types, int numFiles)
+void panCamera(float dt, Input* input, OrthoCamera* cam)
 {
-	Shader s;
-	if (!s.init(files, types, numFiles))
-	{
-		logError("Shader init failed");
-		int i;
-		std::cin >> i;
-		return false;
-	}
-	gShaders[name] = s;
-	return true;
+	if (input->xAxis == 0.0f && input->yAxis == 0.0f) return;
+
+	glm::vec3 delta = { input->xAxis * CAMERA_SPEED * dt, input->yAxis * CAMERA_SPEED * dt, 0.0f };
+	moveCamera(cam, delta);
 }
 
-void render(SDL_Window* w, Camera* c, const std::vector<Drawable*>& drawableObjects)
+double millisecondsSince(Uint64 start)
+{
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+static RenderQueue gRenderQueue;
+static CameraLatch gCameraLatch;
+static LatencyHarness gLatencyHarness;
+static FragmentCounter gFragmentCounter;
+static uint64_t gFragmentsPerMode[2] = { 0, 0 }; // Without and with the depth prepass
+
+// Runs wherever the context lives: the render thread, or inline without one
+void renderFramePacket(SDL_Window* w, FramePacket& packet)
 {
 	glClearColor(0.0f, 0.0f, 0.1f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
+	glClear(packet.depthPrepass ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT);
+	beginFragmentCount(gFragmentCounter);
 
-	for (auto drawable : drawableObjects)
+	// Drawables take a mutable camera, the packet's copy stays as recorded
+	OrthoCamera cam = packet.camera;
+	packet.latchGainSeconds = 0.0;
+	if (packet.lateLatch)
 	{
-		drawable->draw(w, c);
+		// The update thread may have sampled input again since recording
+		// this frame: draw with the newest view, unless it moved further
+		// than culling allowed for
+		OrthoCamera latched;
+		TPacingClock::time_point sampleTime;
+		if (readLatchedCamera(gCameraLatch, latched, sampleTime) && sampleTime > packet.inputTime)
+		{
+			glm::vec3 moved = latched.eye - packet.camera.eye;
+			if (std::fabs(moved.x) <= packet.cullMargin && std::fabs(moved.y) <= packet.cullMargin)
+			{
+				cam = latched;
+				packet.latchGainSeconds = std::chrono::duration<double>(sampleTime - packet.inputTime).count();
+			}
+		}
 	}
+	publishFrameUniforms(gFrameData, &cam, packet.time, packet.viewportWidth, packet.viewportHeight);
+	gRenderQueue.depthPrepass = packet.depthPrepass;
+	clearRenderQueue(gRenderQueue, &cam);
+	submitPacketDraws(gRenderQueue, packet);
+	sortRenderQueue(gRenderQueue);
+	flushRenderQueue(gRenderQueue, w, &cam);
+	endFragmentCount(gFragmentCounter);
+
+	packet.swapSeconds = swapWindowTimed(w);
+	packet.presentTime = TPacingClock::now();
+	finishLatencyProbeFrame(packet);
+
+	packet.stats = gRenderQueue.stats;
+	packet.fragments = gFragmentCounter.lastCount;
+}
 
-	SDL_GL_SwapWindow(w);
-
+// Numbers come back with the packet, a frame or two behind
+void logRenderStats(const FramePacket& packet)
+{
+	const RenderQueueStats& stats = packet.stats;
+	std::ostringstream sstream;
+	sstream << "Render queue: " << stats.commands << " draws (" << stats.culled << " culled), " << stats.stateChangesSorted << " state changes ("
+		<< stats.stateChangesUnsorted << " unsorted), " << stats.radixPasses << " radix passes";
+	logInfo(sstream.str().c_str());
+
+	// Counts lag a few frames, so right after a toggle they may still be the old mode's
+	gFragmentsPerMode[packet.depthPrepass] = packet.fragments;
+	sstream.str("");
+	sstream << "Fragments: " << packet.fragments << " (depth prepass " << (packet.depthPrepass ? "on" : "off") << ")";
+	if (gFragmentsPerMode[0] > 0 && gFragmentsPerMode[1] > 0)
+	{
+		sstream << ", prepass saves " << 100.0 * (1.0 - gFragmentsPerMode[1] / (double)gFragmentsPerMode[0]) << "%";
+	}
+	logInfo(sstream.str().c_str());
 }
 
 
-void handleInput(SDL_Event& event, bool& quit, Input* input)
+// Held keys only, events are left queued. Cheap enough to call again late in
+// the frame.
+void sampleInputAxes(bool& quit, Input* input)
 {
-	input->reset();
+	input->xAxis = input->yAxis = 0.0f;
 
 	const Uint8* keyState = SDL_GetKeyboardState(NULL);
 
@@ -250,224 +370,386 @@ void handleInput(SDL_Event& event, bool& quit, Input* input)
 			input->yAxis = -1.0f;
 		}
 	}
-	
-		
+}
+
+void handleInput(SDL_Event& event, bool& quit, Input* input)
+{
+	input->reset();
+	sampleInputAxes(quit, input);
+
 	while (SDL_PollEvent(&event)) 
 	{
 		if (event.type == SDL_QUIT) 
 		{
 			quit = true;
 		}
+		else if (event.type == SDL_KEYDOWN && !event.key.repeat && event.key.keysym.scancode == SDL_SCANCODE_P)
+		{
+			input->toggleDepthPrepass = true;
+		}
+		else
+		{
+			uint32_t probe = getLatencyProbe(gLatencyHarness, event);
+			if (probe != NO_LATENCY_PROBE)
+			{
+				input->latencyProbe = probe;
+			}
+		}
 	}
 }
 
-class Tentacle
-{
-public:
-	Tentacle(int idx, const glm::vec2& a, const glm::vec2& b, float speed, float t1, float t2, float amp, float width, unsigned int colour, float sideSpeed, float sideAmplitude)
-		:a(a),
-		b(b),
-		controlSpeed(speed),
-		segmentRatio1(t1),
-		segmentRatio2(t2),
-		controlAmplitude(amp),
-		line("tentacle_" + std::to_string(idx)),
-		time(0.f),
-		width(width),
-		colour(colour),
-		numSteps(20),
-		sideSpeed(sideSpeed),
-		sideAmplitude(sideAmplitude)
-	{}
-	~Tentacle()
-	{}
-
-	void init()
-	{
-		line.colourRGBA[0] = ((colour & (0xff << 24)) >> 24)/(float)255.f;
-		line.colourRGBA[1] = ((colour & (0xff << 16)) >> 16)/ (float)255.f;
-		line.colourRGBA[2] = ((colour & (0xff << 8)) >> 8)/ (float)255.f;
-		line.colourRGBA[3] = (colour & (0xff)) / (float)255.f;
-		line.alphaBlend = true;
-		int numPoints = numSteps + 1;
-
-		std::vector<GLfloat> colours;
-		float alphaStep = 1 / (float)numPoints;
-		for (int i = 0; i < numPoints; ++i)
-		{
-			float red = ((colour & (0xff << 24)) >> 24) / (float)255.f;
-			red *= (1 - alphaStep*i);
-			colours.push_back(red);
-			colours.push_back(((colour & (0xff << 16)) >> 16) / (float)255.f);
-			colours.push_back(((colour & (0xff << 8)) >> 8) / (float)255.f);
-			float alpha = (colour & (0xff)) / (float)255.f;
-			alpha *= (1 - alphaStep*i);
-			colours.push_back(alpha);
-		}
-		line.setPointColours(colours);
-
-		line.linePointWidths.resize(numPoints);
-		float step = 1 / (float)numPoints;
-		for (int i = 0; i < numPoints; ++i)
-		{
-			line.linePointWidths[i] = width * (1 - step*i);
-		}
-		//line.lineWidth = width;
-		line.shaderName = LINE_SHADER_NAME;
-
-		time = 0.15f;
-
-		glm::vec2 ab = b - a;
-		float abLen = glm::length(ab);
-		glm::vec2 dir = glm::normalize(ab);
-		normal = glm::normalize(glm::vec2(-ab.y, ab.x ));
-
-		ref1 = a + dir*(segmentRatio1*abLen);
-		ref2 = a + dir*(segmentRatio2*abLen);
-
-		updateControlPoints();
-		initGeometry(line);
-		updateGeometry(line);
-	}
-
-	void updateControlPoints()
-	{
-		glm::vec2 newb = b;
-		newb.y += sideAmplitude * sin(sideSpeed * time);
-
-		glm::vec2 ab = newb - a;
-		float abLen = glm::length(ab);
-		glm::vec2 dir = glm::normalize(ab);
-		glm::vec2 localNormal = glm::normalize(glm::vec2(-ab.y, ab.x));
-
-		ref1 = a + dir*(segmentRatio1*abLen);
-		ref2 = a + dir*(segmentRatio2*abLen);
-
-		float delta = cos(controlSpeed*time);		
-		control1 = ref1 + localNormal*controlAmplitude  *delta;
-		control2 = ref2 - localNormal*controlAmplitude *delta;
-		cubicBezier(a, newb, control1, control2, line, numSteps);
-	}
-
-	void update(float dt)
-	{
-		time += dt;
-		updateControlPoints();
-		updateGeometry(line);
-	}
-	LineRenderer* getLine() 
-	{
-		return &line;
-	}
-private:
-	float sideSpeed;
-	float controlSpeed;
-	float sideAmplitude;
-	float segmentRatio1; // Percentage of ab, for the first control point
-	float segmentRatio2; // Percentage of ab for the second...
-	float controlAmplitude;
-	float time;
-	unsigned int colour;
-	float width;
-	int numSteps;
-
-	glm::vec2 a;
-	glm::vec2 b;
-	glm::vec2 normal;
-	glm::vec2 ref1;
-	glm::vec2 ref2;
-
-	glm::vec2 control1;
-	glm::vec2 control2;
-	LineRenderer line;
-};
-
 template <typename T> int sgn(T val) {
 	return (T(0) < val) - (val < T(0));
 }
 
 int main(int argc, char* args[])
 {
+	bool gpuTilemap = false;
+	const char* streamMapPath = nullptr;
+	int numAnimatedSprites = 0;
+	int numTentacles = 16;
+	double simulationHz = 60.0;
+	VsyncMode vsyncMode = VsyncMode::On;
+	double frameCap = 0.0;
+	bool lateLatch = false;
+	double vsyncLeadMs = 0.0;
+	size_t latencyProbes = 0;
+	bool headless = false;
+	bool showStats = false;
+	bool depthPrepass = false;
+	bool shaderCache = true;
+	bool serialStartup = false;
+	int numJobThreads = 0;
+	bool renderOnThread = true;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(args[i], "--gpu-tilemap") == 0)
+		{
+			gpuTilemap = true;
+		}
+		else if (strcmp(args[i], "--stream-map") == 0 && i + 1 < argc)
+		{
+			streamMapPath = args[++i];
+		}
+		else if (strcmp(args[i], "--bench-sort") == 0)
+		{
+			size_t count = (i + 1 < argc) ? (size_t)atoi(args[i + 1]) : 0;
+			runDrawOrderBenchmark(count > 0 ? count : 100000, 120);
+			return 0;
+		}
+		else if (strcmp(args[i], "--bench-cull") == 0)
+		{
+			size_t count = (i + 1 < argc) ? (size_t)atoi(args[i + 1]) : 0;
+			runCullingBenchmark(count > 0 ? count : 1000000, 100);
+			return 0;
+		}
+		else if (strcmp(args[i], "--bench-jobs") == 0)
+		{
+			size_t count = (i + 1 < argc) ? (size_t)atoi(args[i + 1]) : 0;
+			runJobBenchmark(count > 0 ? count : 4096, 100);
+			return 0;
+		}
+		else if (strcmp(args[i], "--bench-tentacles") == 0)
+		{
+			size_t count = (i + 1 < argc) ? (size_t)atoi(args[i + 1]) : 0;
+			runTentacleBenchmark(count > 0 ? count : 100000, 100);
+			return 0;
+		}
+		else if (strcmp(args[i], "--tentacles") == 0 && i + 1 < argc)
+		{
+			numTentacles = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--sim-hz") == 0 && i + 1 < argc)
+		{
+			simulationHz = atof(args[++i]);
+		}
+		else if (strcmp(args[i], "--vsync") == 0 && i + 1 < argc)
+		{
+			if (!parseVsyncMode(args[++i], vsyncMode))
+			{
+				logError("--vsync takes off, on or adaptive");
+			}
+		}
+		else if (strcmp(args[i], "--fps-cap") == 0 && i + 1 < argc)
+		{
+			frameCap = atof(args[++i]);
+		}
+		else if (strcmp(args[i], "--late-latch") == 0)
+		{
+			lateLatch = true;
+		}
+		else if (strcmp(args[i], "--vsync-lead") == 0 && i + 1 < argc)
+		{
+			vsyncLeadMs = atof(args[++i]);
+		}
+		else if (strcmp(args[i], "--measure-latency") == 0)
+		{
+			size_t count = (i + 1 < argc && args[i + 1][0] != '-') ? (size_t)atoi(args[++i]) : 0;
+			latencyProbes = count > 0 ? count : 200;
+		}
+		else if (strcmp(args[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (strcmp(args[i], "--no-render-thread") == 0)
+		{
+			renderOnThread = false;
+		}
+		else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc)
+		{
+			numJobThreads = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--stats") == 0)
+		{
+			showStats = true;
+		}
+		else if (strcmp(args[i], "--depth-prepass") == 0)
+		{
+			depthPrepass = true;
+		}
+		else if (strcmp(args[i], "--no-shader-cache") == 0)
+		{
+			shaderCache = false;
+		}
+		else if (strcmp(args[i], "--serial-startup") == 0)
+		{
+			serialStartup = true;
+		}
+		else if (strcmp(args[i], "--anim-sprites") == 0 && i + 1 < argc)
+		{
+			numAnimatedSprites = atoi(args[++i]);
+		}
+	}
+
 	const int WINDOWS_WIDTH = 800;
 	const int WINDOWS_HEIGHT = 600;
-	if (!init("OpenGL 4.5", false, WINDOWS_WIDTH, WINDOWS_HEIGHT))
+	if (!init("OpenGL 4.5", false, WINDOWS_WIDTH, WINDOWS_HEIGHT, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, headless))
 	{
 		return -1;
 	}
 
+	if (showStats)
+	{
+		initFragmentCounter(gFragmentCounter);
+	}
+
 	const glm::vec3 CAM_EYE = { 0.0f, 0.0f, 0.8f };
 	const glm::vec3 CAM_TARGET = glm::zero<glm::vec3>();
 	const glm::vec3 CAM_UP = { 0.0f, 1.0f, 0.f };
 
 	initOrtho(&gCam, CAM_EYE , CAM_TARGET, CAM_UP, { -SCREEN_WIDTH / 2, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, -SCREEN_HEIGHT / 2 }, -1.f, 1.f);
-	updateCameraViewMatrix(&gCam);
-	updateCameraProjectionMatrix(&gCam);
+	updateCamera(&gCam);
+	initFrameData(gFrameData);
+	initJobSystem(numJobThreads);
 
 	//initPerspective(&gPerspectiveCam, { 0.f, 0.f, 965.68f }, { 0.f, 0.f,0.f }, { 0.f, 1.f,0.f }, glm::radians(45.f), WINDOWS_WIDTH / (float)WINDOWS_HEIGHT, 0.1f, 965.68f);
-	//updateCameraViewMatrix(&gPerspectiveCam);
-	//updateCameraProjectionMatrix(&gPerspectiveCam);
+	//updateCamera(&gPerspectiveCam);
 
-	const int DEFAULT_SPRITE_SHADER_NUM_FILES = 2;
-	const char* fileNames[DEFAULT_SPRITE_SHADER_NUM_FILES] = { "data/shader/text.vert", "data/shader/text.frag" };
+	if (shaderCache)
+	{
+		char* prefPath = SDL_GetPrefPath("wildrabbit", "cppskelly");
+		if (prefPath != nullptr)
+		{
+			setShaderCacheDir(prefPath);
+			SDL_free(prefPath);
+		}
+	}
+	static const std::string texPath("data/textures/chara_b.png");
+	static const std::string landSheetPath("data/textures/Tilesheet-land-v5.png");
+	const std::vector<std::string> gpuTilemapSheets = {
+		landSheetPath,
+		"data/textures/Tilesheet-water.png",
+		"data/textures/Tilesheet_snow.png",
+		"data/textures/Tilesheets-nature.png"
+	};
+
+	// Images decode on worker threads while the driver compiles shaders.
+	// --serial-startup does one thing at a time, for comparison.
+	Uint64 startupStart = SDL_GetPerformanceCounter();
+	if (!serialStartup)
+	{
+		initParallelShaderCompile((GLADloadproc)SDL_GL_GetProcAddress);
+		prefetchTextures(gpuTilemap ? gpuTilemapSheets : std::vector<std::string>{ landSheetPath });
+		if (numAnimatedSprites > 0)
+		{
+			prefetchTextures({ texPath });
+		}
+	}
 
-	const int LINE_SHADER_NUM_FILES = 2;
-	const char* lineNames[LINE_SHADER_NUM_FILES] = { "data/shader/line.vert","data/shader/line.frag" };
+	const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	const std::vector<GLenum> vertFrag(types, types + 2);
+	registerShaderProgram(DEFAULT_SHADER_NAME, { { "data/shader/basic.vert", "data/shader/basic.frag" }, vertFrag, SHADER_TEXTURED | SHADER_PALETTED | SHADER_ALPHA_TEST });
+	registerShaderProgram(LINE_SHADER_NAME, { { "data/shader/basic.vert", "data/shader/basic.frag" }, vertFrag, SHADER_VERTEX_COLOUR });
+	registerShaderProgram(GPU_TILEMAP_SHADER_NAME, { { "data/shader/tilemap_gpu.vert", "data/shader/tilemap_gpu.frag" }, vertFrag, SHADER_ALPHA_TEST });
+	registerShaderProgram(ANIMATED_SPRITE_SHADER_NAME, { { "data/shader/sprite_anim.vert", "data/shader/basic.frag" }, vertFrag, SHADER_TEXTURED | SHADER_ALPHA_TEST });
+
+	// Variants the scene starts with; anything else is compiled on first use
+	std::vector<ShaderRequest> shaderRequests = {
+		{ DEFAULT_SHADER_NAME, SHADER_TEXTURED },
+		{ DEFAULT_SHADER_NAME, SHADER_TEXTURED | SHADER_PALETTED },
+		{ DEFAULT_SHADER_NAME, SHADER_TEXTURED | SHADER_ALPHA_TEST },
+		{ LINE_SHADER_NAME, SHADER_VERTEX_COLOUR },
+		{ ANIMATED_SPRITE_SHADER_NAME, SHADER_TEXTURED }
+	};
+	if (gpuTilemap)
+	{
+		shaderRequests.push_back({ GPU_TILEMAP_SHADER_NAME, SHADER_ALPHA_TEST });
+	}
+	createShaders(shaderRequests, !serialStartup);
+	double shadersMs = millisecondsSince(startupStart);
+	
+	// Background: a big static map, only the chunks around the camera get built
+	const int MAP_SIZE = 4096;
+	const int SHEET_TILE_SIZE = 32;
+	Tilemap background("background");
+	GpuTilemap gpuBackground("background_gpu");
+	StreamingTilemap streamedBackground("background_streamed");
+	std::vector<Drawable*> drawables;
+	if (streamMapPath != nullptr)
+	{
+		std::ifstream existing(streamMapPath);
+		if (!existing)
+		{
+			// First run: bake a test world to disk, it never needs to fit in memory
+			const int STREAM_MAP_SIZE = 8192;
+			logInfo("Writing streaming map...");
+			writeTilemapFile(streamMapPath, STREAM_MAP_SIZE, STREAM_MAP_SIZE, [](int x, int y) { return (uint16_t)(((x / 7) ^ (y / 5)) % 120); });
+		}
+		existing.close();
 
-	GLenum types[DEFAULT_SPRITE_SHADER_NUM_FILES] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
-	createShader(DEFAULT_SHADER_NAME, fileNames, types, DEFAULT_SPRITE_SHADER_NUM_FILES);
-	createShader(LINE_SHADER_NAME, lineNames, types, LINE_SHADER_NUM_FILES);
+		if (initStreamingTilemap(streamedBackground, streamMapPath, landSheetPath, DEFAULT_SHADER_NAME, SHEET_TILE_SIZE, SHEET_TILE_SIZE, { 32.f, 32.f }))
+		{
+			streamedBackground.origin = { -streamedBackground.header.width * 16.f, -streamedBackground.header.height * 16.f };
+			drawables.push_back(&streamedBackground);
+		}
+	}
+	else if (gpuTilemap)
+	{
+		if (initGpuTilemap(gpuBackground, gpuTilemapSheets, SHEET_TILE_SIZE, SHEET_TILE_SIZE, MAP_SIZE, MAP_SIZE, { 32.f, 32.f }))
+		{
+			gpuBackground.origin = { -MAP_SIZE * 16.f, -MAP_SIZE * 16.f };
+			std::vector<uint16_t> layers((size_t)MAP_SIZE * MAP_SIZE);
+			for (int y = 0; y < MAP_SIZE; ++y)
+			{
+				for (int x = 0; x < MAP_SIZE; ++x)
+				{
+					layers[(size_t)y * MAP_SIZE + x] = (uint16_t)(((x / 7) ^ (y / 5)) % gpuBackground.numLayers);
+				}
+			}
+			setGpuTiles(gpuBackground, layers);
+			drawables.push_back(&gpuBackground);
+		}
+	}
+	else if (initTilemap(background, landSheetPath, DEFAULT_SHADER_NAME, MAP_SIZE, MAP_SIZE, SHEET_TILE_SIZE, SHEET_TILE_SIZE, { 32.f, 32.f }))
+	{
+		background.origin = { -MAP_SIZE * 16.f, -MAP_SIZE * 16.f };
+		std::vector<uint16_t> tiles((size_t)MAP_SIZE * MAP_SIZE);
+		const int numSheetTiles = background.tileset.columns * background.tileset.rows;
+		for (int y = 0; y < MAP_SIZE; ++y)
+		{
+			for (int x = 0; x < MAP_SIZE; ++x)
+			{
+				tiles[(size_t)y * MAP_SIZE + x] = (uint16_t)(((x / 7) ^ (y / 5)) % numSheetTiles);
+			}
+		}
+		setTiles(background, tiles);
+		drawables.push_back(&background);
+	}
 
-	static const std::string spriteName("chara");
-	static const std::string texPath("data/textures/chara_b.png");
-	
-	Sprite sprite(spriteName);
-	initSprite(sprite, texPath, DEFAULT_SHADER_NAME, 64.f,64.f);
-	sprite.pos.x = 2.0f;
-	sprite.pos.y = 1.f;
-	sprite.angle = 0.0f;
-	sprite.scale.xy = 1.f;
-	sprite.velocity.xy = 0.0f;
-	sprite.speed = 300.0f;
-
-	sprite.alphaBlend = true;
-	setPivotType(sprite, PivotType::Centre);
-
-	std::vector<Tentacle> tentacles;
-	std::vector<Drawable*> tentacleViews;
+	TentacleSystem tentacles("tentacles");
+	initTentacleSystem(tentacles, 20);
 	const float speed = 5.f;
 	const float maxLineWidth = 8.f;
 	const unsigned int colour = 0x880fbbff;
 	const float t1 = 0.25f;
 	const float t2 = 0.75f;
-	float amplitude = 200.f;
 	const float tentacleLen = 450.f;
+	const int fanTentacles = 16;
+	const float fanSpacing = 1000.f;
 
-	glm::vec2 a = { 0.f,-270.f };
-	float spread = 170.f;
-	const int numTentacles = 16;
-	tentacles.reserve(numTentacles);
-	float spreadStep = spread / (float)numTentacles;
+	// Fans of 16 side by side, --tentacles asks for more of them
+	int numFans = std::max(1, (numTentacles + fanTentacles - 1) / fanTentacles);
+	for (int fan = 0; fan < numFans; ++fan)
+	{
+		glm::vec2 a = { fan * fanSpacing, -270.f };
+		float spread = 170.f;
+		float spreadStep = spread / (float)fanTentacles;
+		float amplitude = 200.f;
+		float sideAmplitude = 25.f;
+		float sideSpeed = 5.5f;
+
+		int halvedTentacles = fanTentacles / 2;
+		for (int i = 0; i < halvedTentacles; ++i)
+		{
+			glm::vec2 b = { a.x + tentacleLen * cos(glm::radians(spread)), a.y + tentacleLen * sin(glm::radians(spread)) };
+			int sign = sgn(b.x - a.x);
+			TentacleParams params = { a, b, speed * sign, t1, t2, amplitude * sign, maxLineWidth, colour, sideSpeed, sideAmplitude, 0.15f };
+			addTentacle(tentacles, params);
+
+			params.b.x = 2 * a.x - b.x;
+			params.controlAmplitude = amplitude * -sign;
+			addTentacle(tentacles, params);
+
+			amplitude *= 0.9f;
+			sideAmplitude *= 0.9f;
+			spread -= spreadStep;
+		}
+	}
+	buildTentacleGeometry(tentacles, 1.0f);
+	buildTentacleBuffers(tentacles);
+
+	// Tentacles over the map, the crowd over both
+	tentacles.layer = 1;
+	drawables.push_back(&tentacles);
+
+	// Crowd of walkers. chara_b only has the one pose, so every direction's
+	// clip is that single frame until there's a proper walk sheet. They live
+	// in the entity world, the batch only draws them.
+	const ComponentMask moverMask = componentBit(COMPONENT_POSITION) | componentBit(COMPONENT_PREVIOUS_POSITION) | componentBit(COMPONENT_VELOCITY);
+	const ComponentMask spriteMask = componentBit(COMPONENT_ANIMATION) | componentBit(COMPONENT_SPRITE_INSTANCE);
+	EntityWorld world;
+	SpriteSheet charaSheet;
+	AnimatedSpriteBatch crowd("crowd");
+	if (numAnimatedSprites > 0 && initSpriteSheet(charaSheet, "chara", texPath))
+	{
+		const char* clipNames[] = { "walk_down", "walk_left", "walk_right", "walk_up" };
+		for (const char* clipName : clipNames)
+		{
+			addGridClip(charaSheet, clipName, 0, 0, 1, charaSheet.texWidth, charaSheet.texHeight, 0.15f, true);
+		}
+		buildSheetHulls(charaSheet, texPath);
+		uploadFrameTable(charaSheet);
 
-	float sideAmplitude = 25.f;
-	float sideSpeed = 5.5f;
+		if (initAnimatedSpriteBatch(crowd, &charaSheet, { 64.f, 64.f }, PivotType::Centre))
+		{
+			crowd.ySort = true;
+			for (int i = 0; i < numAnimatedSprites; ++i)
+			{
+				glm::vec2 pos = { (float)(rand() % SCREEN_WIDTH - SCREEN_WIDTH / 2), (float)(rand() % SCREEN_HEIGHT - SCREEN_HEIGHT / 2) };
+				EntityID walker = createEntity(world, moverMask | spriteMask | componentBit(COMPONENT_WALKER));
+				placeEntity(world, walker, pos);
+				AnimationState* animation = getComponent<AnimationState>(world, walker);
+				animation->clip = (uint16_t)(i % 4);
+				animation->speed = 0.75f + (rand() % 50) / 100.f;
+				animation->time = (rand() % 60) / 100.f;
+				animation->frame = advanceClip(charaSheet.clips[animation->clip], animation->time, 0.0f);
+				Walker* walk = getComponent<Walker>(world, walker);
+				walk->speed = animation->speed;
+				walk->rng = 2654435761u * (uint32_t)(i + 1);
+			}
+			crowd.layer = 2;
+			drawables.push_back(&crowd);
+		}
+	}
 
-	int halvedTentacles = numTentacles / 2;
-	for (int i = 0; i < halvedTentacles; ++i)
+	// Arrow keys steer it, drawn with the crowd when there is one
+	EntityID player = createEntity(world, moverMask | componentBit(COMPONENT_PLAYER_CONTROL) | (crowd.sheet != nullptr ? spriteMask : 0));
+	placeEntity(world, player, { 2.0f, 1.0f });
+	getComponent<PlayerControl>(world, player)->speed = 300.0f;
+	if (crowd.sheet != nullptr)
 	{
-		glm::vec2 b = { a.x + tentacleLen * cos(glm::radians(spread)), a.y + tentacleLen * sin(glm::radians(spread)) };
-		int sign = sgn(b.x);
-		tentacles.emplace_back(2*i + 1, a, b, speed * sign, t1, t2, amplitude * sign, maxLineWidth, colour, sideSpeed, sideAmplitude);
-		tentacles.back().init();
-		tentacleViews.push_back(tentacles.back().getLine());
-
-		b.x = -b.x;
-		tentacles.emplace_back(2*(i+ 1), a, b, speed * sign, t1, t2, amplitude * -sign, maxLineWidth, colour, sideSpeed, sideAmplitude);
-		tentacles.back().init();
-		tentacleViews.push_back(tentacles.back().getLine());
-
-		amplitude *= 0.9f;
-		sideAmplitude *= 0.9f;
-		spread -= spreadStep;
+		getComponent<SpriteInstance>(world, player)->sortLayer = 1;
+		getComponent<AnimationState>(world, player)->speed = 1.0f;
 	}
 
 	//Tentacle t(0, { 0.f,-300 }, { 400.f,0.f }, -3.f, 0.25f, 0.75f, 200.f, 6.f, 0xAA33EEFF);
@@ -483,31 +765,179 @@ int main(int argc, char* args[])
 	//Tentacle t4(0, { 0.f,-300 }, { 300.f,200.f }, -3.f, 0.25f, 0.75f, 200.f, 6.f, 0xAA33EEFF);
 	//t4.init();
 
+	{
+		// Run twice to compare a cold shader cache with a warm one
+		std::ostringstream sstream;
+		sstream << "Startup took " << millisecondsSince(startupStart) << " ms (" << (serialStartup ? "serial" : "parallel") << "), shaders " << shadersMs << " ms: "
+			<< gShaderCacheStats.loaded << " from the binary cache, " << gShaderCacheStats.compiled << " compiled";
+		logInfo(sstream.str().c_str());
+	}
+
 	SDL_Event event;
 	bool quit = false;
 	
 	switchTimeout = 0.0f;
 	drawLine = true;
 	// Init timer!
-	std::chrono::time_point<std::chrono::system_clock> start, end;
-	start = std::chrono::system_clock::now();
+	std::chrono::time_point<std::chrono::steady_clock> start, end;
+	start = std::chrono::steady_clock::now();
 	float elapsedSecs = 0.0f;
+	FixedTimestep timestep;
+	initFixedTimestep(timestep, simulationHz);
+	const float stepSeconds = (float)timestep.stepSeconds;
+	float statsTimeout = 0.0f;
+	uint64_t frameNumber = 0;
+	FramePacer pacer;
+	setVsyncMode(pacer, vsyncMode);
+	setFrameCap(pacer, frameCap);
+	pacer.vsyncLeadSeconds = vsyncLeadMs / 1000.0;
+	SDL_DisplayMode displayMode;
+	if (SDL_GetWindowDisplayMode(window, &displayMode) == 0)
+	{
+		setRefreshRate(pacer, displayMode.refresh_rate);
+	}
+	TPacingClock::time_point lastInputSample = TPacingClock::now();
+	double latchGainTotal = 0.0;
+	int latchedFrames = 0;
+	if (latencyProbes > 0)
+	{
+		initLatencyHarness(gLatencyHarness, latencyProbes, LATENCY_PROBE_INTERVAL);
+	}
+	// From here on the GL context belongs to the render thread
+	RenderThread renderThread;
+	startRenderThread(renderThread, window, maincontext, renderFramePacket, renderOnThread);
 	Input input = { 0 };
 	while (!quit) 
 	{    
-		end = std::chrono::system_clock::now();
-		float elapsedSeconds = std::chrono::duration_cast<std::chrono::duration<float>>(end - start).count();
+		waitForNextFrame(pacer);
+		waitForVsyncLead(pacer);
+		end = std::chrono::steady_clock::now();
+		double frameSeconds = std::chrono::duration<double>(end - start).count();
+		float elapsedSeconds = (float)frameSeconds;
 		start = end;
+		if (frameNumber > 0)
+		{
+			addFrameTime(pacer.frameTimes, frameSeconds);
+		}
 		handleInput(event, quit, &input);
-		//update(elapsedSeconds, &input, &sprite);
-		for (Tentacle& t : tentacles)
+		// The camera moves by the time since input was last sampled, which
+		// late latching also does at the end of the frame
+		TPacingClock::time_point inputSample = TPacingClock::now();
+		panCamera(std::chrono::duration<float>(inputSample - lastInputSample).count(), &input, &gCam);
+		lastInputSample = inputSample;
+		updateCamera(&gCam);
+		if (lateLatch)
+		{
+			latchCamera(gCameraLatch, gCam, inputSample);
+		}
+		if (input.toggleDepthPrepass)
 		{
-			t.update(elapsedSeconds);
+			depthPrepass = !depthPrepass;
+			logInfo(depthPrepass ? "Depth prepass on" : "Depth prepass off");
 		}
-		render(window, &gCam, tentacleViews);
+		// The simulation only ever sees whole steps, the same on any machine.
+		// The camera follows input, so it keeps the frame's own time.
+		int steps = advanceFixedTimestep(timestep, elapsedSeconds);
+		for (int step = 0; step < steps; ++step)
+		{
+			stepTentacles(tentacles, stepSeconds);
+			updatePlayerControl(world, { input.xAxis, input.yAxis });
+			updateWalkers(world);
+			updateMovement(world, stepSeconds);
+			if (crowd.sheet != nullptr)
+			{
+				updateEntityAnimations(world, charaSheet, stepSeconds);
+			}
+		}
+		// Draw between the last two steps. Curves and vertices are built
+		// across the job threads.
+		float alpha = getInterpolationAlpha(timestep);
+		buildTentacleGeometry(tentacles, alpha);
+		if (crowd.sheet != nullptr)
+		{
+			extractSpriteInstances(world, crowd, alpha);
+		}
+		elapsedSecs += elapsedSeconds;
+
+		// Blocks only if the render thread is still a whole frame behind
+		FramePacket* packet = acquireFramePacket(renderThread);
+		if (packet->rendered)
+		{
+			addFrameTime(pacer.swapTimes, packet->swapSeconds);
+			notePresent(pacer, packet->presentTime);
+			collectLatencyProbe(gLatencyHarness, *packet);
+			if (packet->lateLatch)
+			{
+				latchGainTotal += packet->latchGainSeconds;
+				++latchedFrames;
+			}
+		}
+		statsTimeout -= elapsedSeconds;
+		if (showStats && statsTimeout <= 0.0f && packet->rendered)
+		{
+			logRenderStats(*packet);
+			logFramePacing(pacer);
+			if (latchedFrames > 0)
+			{
+				std::ostringstream sstream;
+				sstream << "Late latch: camera " << latchGainTotal * 1000.0 / latchedFrames << " ms fresher on average";
+				logInfo(sstream.str().c_str());
+				latchGainTotal = 0.0;
+				latchedFrames = 0;
+			}
+			std::ostringstream sstream;
+			sstream << "Simulation: " << timestep.steps << " steps at " << 1.0 / timestep.stepSeconds << " Hz, " << timestep.droppedSteps << " dropped";
+			logInfo(sstream.str().c_str());
+			statsTimeout = 5.0f;
+		}
+		if (lateLatch)
+		{
+			// Sample again right before recording, the simulation above took a
+			// while. The render thread can go one better if input moves on again.
+			SDL_PumpEvents();
+			sampleInputAxes(quit, &input);
+			inputSample = TPacingClock::now();
+			panCamera(std::chrono::duration<float>(inputSample - lastInputSample).count(), &input, &gCam);
+			lastInputSample = inputSample;
+			updateCamera(&gCam);
+			latchCamera(gCameraLatch, gCam, inputSample);
+		}
+		int viewportWidth, viewportHeight;
+		SDL_GL_GetDrawableSize(window, &viewportWidth, &viewportHeight);
+		beginFramePacket(*packet, frameNumber++, gCam, elapsedSecs, viewportWidth, viewportHeight);
+		packet->depthPrepass = depthPrepass;
+		if (input.latencyProbe != NO_LATENCY_PROBE)
+		{
+			tagLatencyProbe(gLatencyHarness, input.latencyProbe, packet->frame, *packet);
+		}
+		if (lateLatch)
+		{
+			packet->lateLatch = true;
+			packet->inputTime = inputSample;
+			packet->cullMargin = CAMERA_SPEED * LATE_LATCH_MAX_SECONDS;
+		}
+		recordFramePacket(*packet, drawables, gRenderQueue.cull);
+		submitFramePacket(renderThread, packet);
+
+		// This frame's input is already sampled, so each probe waits for the
+		// next one: the worst case for an input arriving mid-frame
+		injectLatencyProbe(gLatencyHarness);
+		if (isLatencyHarnessDone(gLatencyHarness))
+		{
+			quit = true;
+		}
+	}
+	stopRenderThread(renderThread);
+	if (gLatencyHarness.active)
+	{
+		logLatencyReport(gLatencyHarness);
 	}
 
-	close(window, maincontext, tentacleViews);
+	cleanupSpriteSheet(charaSheet);
+	cleanupFragmentCounter(gFragmentCounter);
+	cleanupFrameData(gFrameData);
+	shutdownJobSystem();
+	close(window, maincontext, drawables);
 	return 0;
 }
 